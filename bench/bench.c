@@ -0,0 +1,444 @@
+/*
+ * switch - alternatives management tool for NurOS
+ * Copyright (C) 2026 AnmiTaliDev <anmitali198@gmail.com>
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Benchmark of module scanning, evaluation, listing and switching on
+ * synthetic module trees. Results are written as JSON.
+ */
+
+#define _XOPEN_SOURCE 700
+#define _DEFAULT_SOURCE
+
+#include "config.h"
+#include "module.h"
+#include "process.h"
+#include "scan.h"
+#include "utils.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <ftw.h>
+#include <getopt.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+/* Every SLOW_EVERY-th module has a slow find_alternatives */
+#define SLOW_EVERY 20
+#define SLOW_SECONDS "0.02"
+
+/* Counters sampled around a measured phase */
+typedef struct {
+    struct timespec time;
+    unsigned long spawned;
+    unsigned long long forks;
+    unsigned long scan_syscalls;
+} sample_t;
+
+static FILE *g_out;
+static bool g_first_result = true;
+
+/* System-wide fork count; includes processes started by bash itself */
+static unsigned long long read_forks(void)
+{
+    FILE *fp = fopen("/proc/stat", "r");
+    if (!fp) {
+        return 0;
+    }
+
+    char line[256];
+    unsigned long long forks = 0;
+    while (fgets(line, sizeof(line), fp)) {
+        if (sscanf(line, "processes %llu", &forks) == 1) {
+            break;
+        }
+    }
+
+    fclose(fp);
+    return forks;
+}
+
+static void sample(sample_t *s)
+{
+    clock_gettime(CLOCK_MONOTONIC, &s->time);
+    s->spawned = spawn_count();
+    s->forks = read_forks();
+    s->scan_syscalls = scan_syscall_count();
+}
+
+static void report(size_t modules, const char *phase, const char *cache,
+                   const sample_t *start, const sample_t *end)
+{
+    double wall_ms = (double)(end->time.tv_sec - start->time.tv_sec) * 1000.0 +
+                     (double)(end->time.tv_nsec - start->time.tv_nsec) / 1000000.0;
+
+    fprintf(g_out, "%s\n    {\"modules\": %zu, \"phase\": \"%s\", \"cache\": \"%s\", "
+            "\"wall_ms\": %.3f, \"spawned\": %lu, \"forks\": %llu, "
+            "\"scan_syscalls\": %lu}",
+            g_first_result ? "" : ",", modules, phase, cache, wall_ms,
+            end->spawned - start->spawned, end->forks - start->forks,
+            end->scan_syscalls - start->scan_syscalls);
+    g_first_result = false;
+
+    fprintf(stderr, "%5zu modules  %-14s %-5s %10.3f ms  %6lu spawned  %6llu forks"
+            "  %6lu scan syscalls\n",
+            modules, phase, cache, wall_ms,
+            end->spawned - start->spawned, end->forks - start->forks,
+            end->scan_syscalls - start->scan_syscalls);
+}
+
+static int write_file(const char *path, const char *content, mode_t mode)
+{
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, mode);
+    if (fd == -1) {
+        return -1;
+    }
+
+    size_t len = strlen(content);
+    ssize_t n = write(fd, content, len);
+    close(fd);
+    return n == (ssize_t)len ? 0 : -1;
+}
+
+/*
+ * Module kinds rotate so that every evaluation path is exercised: literal
+ * metadata with and without MODULE_WATCH, and dynamic metadata that needs
+ * bash with and without MODULE_WATCH.
+ */
+static int generate_module(const char *root, size_t index)
+{
+    char path[4096];
+    char script[4096];
+    bool dynamic = index % 2 == 1;
+    bool watched = index % 4 < 2;
+    bool slow = index % SLOW_EVERY == 0;
+
+    snprintf(script, sizeof(script),
+             "#!/bin/bash\n"
+             "MODULE_NAME=\"bench-%04zu\"\n"
+             "MODULE_CATEGORY=%s\n"
+             "MODULE_DESCRIPTION=\"Benchmark module %zu\"\n"
+             "MODULE_LINK=\"%s/links/bench-%04zu\"\n"
+             "%s%s%s"
+             "find_alternatives() {\n"
+             "%s"
+             "    for alt in %s/bin/alt-*; do\n"
+             "        echo \"$alt|${alt##*-}|10\"\n"
+             "    done\n"
+             "}\n",
+             index, dynamic ? "\"$(echo bench)\"" : "\"bench\"", index,
+             root, index,
+             watched ? "MODULE_WATCH=\"" : "", watched ? root : "",
+             watched ? "/bin\"\n" : "",
+             slow ? "    sleep " SLOW_SECONDS "\n" : "",
+             root);
+
+    snprintf(path, sizeof(path), "%s/modules/bench-%04zu.sh", root, index);
+    return write_file(path, script, 0755);
+}
+
+static int generate_tree(const char *root, size_t count)
+{
+    static const char *const subdirs[] = { "modules", "system", "bin", "links" };
+    char path[4096];
+
+    for (size_t i = 0; i < sizeof(subdirs) / sizeof(subdirs[0]); i++) {
+        snprintf(path, sizeof(path), "%s/%s", root, subdirs[i]);
+        if (make_dirs(path, 0755) != 0) {
+            return -1;
+        }
+    }
+
+    for (char c = 'a'; c <= 'c'; c++) {
+        snprintf(path, sizeof(path), "%s/bin/alt-%c", root, c);
+        if (write_file(path, "#!/bin/sh\n", 0755) != 0) {
+            return -1;
+        }
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        if (generate_module(root, i) != 0) {
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+static int remove_entry(const char *path, const struct stat *st, int flag, struct FTW *ftw)
+{
+    (void)st;
+    (void)flag;
+    (void)ftw;
+    remove(path);
+    return 0;
+}
+
+/* Configuration pointing at the synthetic tree and a per-phase cache */
+static int bench_config(switch_config_t *config, const char *root, const char *cache)
+{
+    char path[4096];
+
+    if (config_init(config) != 0) {
+        return -1;
+    }
+
+    free(config->system_modules_dir);
+    free(config->user_modules_dir);
+    free(config->cache_dir);
+
+    snprintf(path, sizeof(path), "%s/system", root);
+    config->system_modules_dir = strdup(path);
+    snprintf(path, sizeof(path), "%s/modules", root);
+    config->user_modules_dir = strdup(path);
+    snprintf(path, sizeof(path), "%s/cache-%s", root, cache);
+    config->cache_dir = strdup(path);
+
+    if (!config->system_modules_dir || !config->user_modules_dir || !config->cache_dir) {
+        config_free(config);
+        return -1;
+    }
+    return 0;
+}
+
+static int scan(module_list_t *list, const switch_config_t *config)
+{
+    if (module_list_init(list) != 0) {
+        return -1;
+    }
+    if (module_scan(list, config) != 0) {
+        module_list_free(list);
+        return -1;
+    }
+    return 0;
+}
+
+/* Redirect stdout to /dev/null while actions print */
+static int quiet_begin(void)
+{
+    fflush(stdout);
+    int saved = dup(STDOUT_FILENO);
+    int null_fd = open("/dev/null", O_WRONLY | O_CLOEXEC);
+    if (saved == -1 || null_fd == -1) {
+        return -1;
+    }
+    dup2(null_fd, STDOUT_FILENO);
+    close(null_fd);
+    return saved;
+}
+
+static void quiet_end(int saved)
+{
+    fflush(stdout);
+    if (saved != -1) {
+        dup2(saved, STDOUT_FILENO);
+        close(saved);
+    }
+}
+
+typedef enum {
+    PHASE_SCAN,
+    PHASE_METADATA,
+    PHASE_PRINT_LIST,
+    PHASE_ACTION_LIST,
+    PHASE_ACTION_SET
+} phase_t;
+
+static const char *const phase_names[] = {
+    [PHASE_SCAN]        = "scan",
+    [PHASE_METADATA]    = "load_metadata",
+    [PHASE_PRINT_LIST]  = "print_list",
+    [PHASE_ACTION_LIST] = "action_list",
+    [PHASE_ACTION_SET]  = "action_set",
+};
+
+/*
+ * Run one phase on a fresh scan. Caches live in a directory per phase, so
+ * the first run of a phase is cold and the second one warm.
+ */
+static int run_phase(const char *root, size_t count, phase_t phase, const char *cache)
+{
+    switch_config_t config;
+    if (bench_config(&config, root, phase_names[phase]) != 0) {
+        return -1;
+    }
+
+    module_list_t list;
+    sample_t start, end;
+    int ret = 0;
+
+    if (phase == PHASE_SCAN) {
+        sample(&start);
+        ret = scan(&list, &config);
+        sample(&end);
+        if (ret == 0) {
+            report(count, phase_names[phase], cache, &start, &end);
+            module_list_free(&list);
+        }
+        config_free(&config);
+        return ret;
+    }
+
+    if (scan(&list, &config) != 0) {
+        config_free(&config);
+        return -1;
+    }
+
+    int saved = quiet_begin();
+    sample(&start);
+    module_cache_init(&config);
+
+    for (size_t i = 0; i < list.count && ret == 0; i++) {
+        module_info_t *module = &list.modules[i];
+        switch (phase) {
+        case PHASE_METADATA:
+            ret = module_load_metadata(module) == 0 ? 0 : -1;
+            break;
+        case PHASE_ACTION_LIST:
+            ret = module_action_list(module, false) == 0 ? 0 : -1;
+            break;
+        case PHASE_ACTION_SET:
+            ret = module_action_set(module, "b") == 0 ? 0 : -1;
+            break;
+        default:
+            break;
+        }
+    }
+    if (phase == PHASE_PRINT_LIST) {
+        module_print_list(&list, config.jobs);
+    }
+
+    module_cache_finish();
+    sample(&end);
+    quiet_end(saved);
+
+    if (ret == 0) {
+        report(count, phase_names[phase], cache, &start, &end);
+    } else {
+        print_error("Phase %s failed with %zu modules", phase_names[phase], count);
+    }
+
+    module_list_free(&list);
+    config_free(&config);
+    return ret;
+}
+
+static int run_size(const char *tmpdir, size_t count)
+{
+    char root[1024];
+    snprintf(root, sizeof(root), "%s/switch-bench-XXXXXX", tmpdir);
+    if (!mkdtemp(root)) {
+        print_error("Cannot create benchmark directory: %s", strerror(errno));
+        return -1;
+    }
+
+    int ret = generate_tree(root, count);
+    if (ret != 0) {
+        print_error("Cannot generate %zu modules in %s", count, root);
+    }
+
+    if (ret == 0) {
+        ret = run_phase(root, count, PHASE_SCAN, "none");
+    }
+    for (phase_t phase = PHASE_METADATA; ret == 0 && phase <= PHASE_ACTION_SET; phase++) {
+        ret = run_phase(root, count, phase, "cold");
+        if (ret == 0) {
+            ret = run_phase(root, count, phase, "warm");
+        }
+    }
+
+    nftw(root, remove_entry, 16, FTW_DEPTH | FTW_PHYS);
+    return ret;
+}
+
+static void print_usage(const char *progname)
+{
+    printf("Usage: %s [OPTIONS]\n", progname);
+    printf("\n");
+    printf("Benchmark switch on synthetic module trees.\n");
+    printf("\n");
+    printf("Options:\n");
+    printf("  -s, --sizes=N,...     Module counts to test (default: 10,100,1000)\n");
+    printf("  -o, --output=FILE     Write JSON results to FILE (default: stdout)\n");
+    printf("  -h, --help            Show this help message\n");
+}
+
+static struct option long_options[] = {
+    {"sizes",  required_argument, NULL, 's'},
+    {"output", required_argument, NULL, 'o'},
+    {"help",   no_argument,       NULL, 'h'},
+    {NULL,     0,                 NULL, 0}
+};
+
+int main(int argc, char *argv[])
+{
+    const char *sizes = "10,100,1000";
+    const char *output = NULL;
+    int opt;
+
+    while ((opt = getopt_long(argc, argv, "s:o:h", long_options, NULL)) != -1) {
+        switch (opt) {
+        case 's':
+            sizes = optarg;
+            break;
+        case 'o':
+            output = optarg;
+            break;
+        case 'h':
+            print_usage(argv[0]);
+            return 0;
+        default:
+            fprintf(stderr, "Try '%s --help' for more information.\n", argv[0]);
+            return 1;
+        }
+    }
+
+    color_init();
+
+    /* Measure the local evaluation paths only */
+    unsetenv("SWITCH_NO_CACHE");
+    unsetenv("SWITCH_CACHE_STATS");
+
+    g_out = output ? fopen(output, "w") : stdout;
+    if (!g_out) {
+        print_error("Cannot open %s: %s", output, strerror(errno));
+        return 1;
+    }
+
+    const char *tmpdir = getenv("TMPDIR");
+    if (!tmpdir || !*tmpdir) {
+        tmpdir = "/tmp";
+    }
+
+    fprintf(g_out, "{\n  \"version\": \"%s\",\n  \"results\": [", SWITCH_VERSION);
+
+    int ret = 0;
+    char *list = strdup(sizes);
+    char *saveptr = NULL;
+    for (char *item = strtok_r(list, ",", &saveptr); item && ret == 0;
+         item = strtok_r(NULL, ",", &saveptr)) {
+        char *end;
+        long count = strtol(item, &end, 10);
+        if (*end != '\0' || count < 1 || count > 100000) {
+            print_error("Invalid module count '%s'", item);
+            ret = -1;
+            break;
+        }
+        ret = run_size(tmpdir, (size_t)count);
+    }
+    free(list);
+
+    fprintf(g_out, "\n  ]\n}\n");
+    if (g_out != stdout) {
+        fclose(g_out);
+    }
+    return ret == 0 ? 0 : 1;
+}
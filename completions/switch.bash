@@ -0,0 +1,21 @@
+# bash completion for switch
+# Copyright (C) 2026 AnmiTaliDev <anmitali198@gmail.com>
+# SPDX-License-Identifier: GPL-3.0-or-later
+
+_switch()
+{
+    local cur words cword
+    if declare -F _init_completion >/dev/null; then
+        _init_completion -n = || return
+    else
+        words=("${COMP_WORDS[@]}")
+        cword=$COMP_CWORD
+        cur=${COMP_WORDS[COMP_CWORD]}
+    fi
+
+    # Candidates are printed one per line and may contain spaces
+    local IFS=$'\n'
+    COMPREPLY=($(command switch --complete "${words[@]:1:cword}" 2>/dev/null))
+}
+
+complete -o default -F _switch switch
@@ -0,0 +1,17 @@
+# fish completion for switch
+# Copyright (C) 2026 AnmiTaliDev <anmitali198@gmail.com>
+# SPDX-License-Identifier: GPL-3.0-or-later
+
+# "switch" is a fish keyword, so the tool is run as "command switch"
+function __switch_complete
+    set -l tokens (commandline -opc)
+    if test "$tokens[1]" = command
+        set -e tokens[1]
+    end
+    set -e tokens[1]
+    # Quoted, so that an empty current word is still passed
+    set -l cur (commandline -ct)
+    command switch --complete $tokens "$cur" 2>/dev/null
+end
+
+complete -c switch -f -a '(__switch_complete)'
@@ -19,6 +19,9 @@ MODULE_DESCRIPTION="Manage default text editor"
 # Path to the managed symlink
 MODULE_LINK="/usr/bin/editor"
 
+# Directories searched by find_alternatives (colon-separated)
+MODULE_WATCH="/usr/bin"
+
 # ============================================================
 # Search function - finds available alternatives
 # Output format: one alternative per line
@@ -40,7 +43,7 @@ find_alternatives() {
     )
 
     for editor in "${candidates[@]}"; do
-        if [[ -x "$editor" ]]; then
+        if [[ -x "$SWITCH_ROOT$editor" ]]; then
             local name=$(basename "$editor")
             local priority=10
 
@@ -15,6 +15,9 @@ MODULE_LINK="/usr/bin/java"
 # Additional managed links (optional)
 MODULE_EXTRA_LINKS="/usr/bin/javac:/usr/lib/jvm/default"
 
+# Directories searched by find_alternatives
+MODULE_WATCH="/usr/lib/jvm:/opt/java:/opt/jdk"
+
 # ============================================================
 # Search function
 # ============================================================
@@ -25,26 +28,55 @@ find_alternatives() {
         "/opt/java"
         "/opt/jdk"
     )
+    local names=() bins=() versions=()
 
+    # Candidates are looked for in the image tree switch manages, if any
     for dir in "${jvm_dirs[@]}"; do
-        [[ ! -d "$dir" ]] && continue
+        [[ ! -d "$SWITCH_ROOT$dir" ]] && continue
 
-        for jvm in "$dir"/*/; do
+        for jvm in "$SWITCH_ROOT$dir"/*/; do
             jvm="${jvm%/}"
             local name=$(basename "$jvm")
 
             [[ "$name" == "default" ]] && continue
 
             if [[ -x "$jvm/bin/java" ]]; then
-                local priority=10
-                local java_bin="$jvm/bin/java"
+                names+=("$name")
+                bins+=("$jvm/bin/java")
+            fi
+        done
+    done
 
-                # Extract version number for priority
-                local version=$("$java_bin" -version 2>&1 | head -1 | grep -oP '"\K[^"]+' | cut -d. -f1)
-                [[ "$version" =~ ^[0-9]+$ ]] && priority=$((version * 10))
+    [[ ${#bins[@]} -eq 0 ]] && return 0
 
-                echo "$java_bin|$name|$priority"
-            fi
+    # Probe every JVM at once; switch caches the answers per binary
+    if [[ -n "$SWITCH_BIN" ]]; then
+        mapfile -t versions < <("$SWITCH_BIN" --probe-version=-version "${bins[@]}")
+    else
+        local java_bin
+        for java_bin in "${bins[@]}"; do
+            versions+=("$("$java_bin" -version 2>&1 | head -1 | grep -oP '"\K[^"]+')")
         done
+    fi
+
+    local i
+    for i in "${!bins[@]}"; do
+        local priority=10
+        local version="${versions[i]%%.*}"
+
+        # Major version number sets the priority
+        [[ "$version" =~ ^[0-9]+$ ]] && priority=$((version * 10))
+
+        echo "${bins[i]#"$SWITCH_ROOT"}|${names[i]}|$priority"
     done
 }
+
+# Targets of MODULE_EXTRA_LINKS for the selected java binary
+extra_link_targets() {
+    local java_bin="$1"
+    [[ "$java_bin" == */bin/java ]] || return 0
+
+    local jvm="${java_bin%/bin/java}"
+    [[ -x "$SWITCH_ROOT$jvm/bin/javac" ]] && echo "$jvm/bin/javac" || echo
+    echo "$jvm"
+}
@@ -15,6 +15,9 @@ MODULE_LINK="/boot/vmlinuz"
 # Additional managed links
 MODULE_EXTRA_LINKS="/boot/initramfs.img"
 
+# Directories searched by find_alternatives
+MODULE_WATCH="/boot"
+
 # ============================================================
 # Search function
 # ============================================================
@@ -22,16 +25,18 @@ MODULE_EXTRA_LINKS="/boot/initramfs.img"
 find_alternatives() {
     local boot_dir="/boot"
 
-    for kernel in "$boot_dir"/vmlinuz-*; do
+    for kernel in "$SWITCH_ROOT$boot_dir"/vmlinuz-*; do
         [[ ! -f "$kernel" ]] && continue
 
-        local version="${kernel#$boot_dir/vmlinuz-}"
-
-        # Calculate priority from kernel version
-        local major=$(echo "$version" | grep -oP '^\d+' 2>/dev/null || echo "0")
-        local minor=$(echo "$version" | grep -oP '^\d+\.\d+' 2>/dev/null | cut -d. -f2 || echo "0")
-        local priority=$((major * 100 + minor))
+        local version="${kernel#"$SWITCH_ROOT$boot_dir"/vmlinuz-}"
 
-        echo "$kernel|$version|$priority"
+        # switch ranks kernels by version
+        echo "$boot_dir/vmlinuz-$version|$version|10|$version"
     done
 }
+
+# Initramfs matching the selected kernel
+extra_link_targets() {
+    local version="${1#/boot/vmlinuz-}"
+    [[ -f "$SWITCH_ROOT/boot/initramfs-$version.img" ]] && echo "/boot/initramfs-$version.img" || echo
+}
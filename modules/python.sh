@@ -12,24 +12,25 @@ MODULE_CATEGORY="development"
 MODULE_DESCRIPTION="Manage Python interpreter"
 MODULE_LINK="/usr/bin/python"
 
+# Directories searched by find_alternatives
+MODULE_WATCH="/usr/bin"
+
 # ============================================================
 # Search function
 # ============================================================
 
 find_alternatives() {
     # Find python3.x executables
-    for py in /usr/bin/python3.[0-9]*; do
+    for py in "$SWITCH_ROOT"/usr/bin/python3.[0-9]*; do
         if [[ -x "$py" && ! -L "$py" ]]; then
             local name=$(basename "$py")
-            local version="${name#python}"
-            # Convert 3.11 -> 311 for priority
-            local priority=$(echo "$version" | tr -d '.')
-            echo "$py|$name|$priority"
+            # Ranked above python3 itself, newest version first
+            echo "/usr/bin/$name|$name|300|${name#python}"
         fi
     done
 
     # python3 if it's a real binary
-    if [[ -x "/usr/bin/python3" && ! -L "/usr/bin/python3" ]]; then
+    if [[ -x "$SWITCH_ROOT/usr/bin/python3" && ! -L "$SWITCH_ROOT/usr/bin/python3" ]]; then
         echo "/usr/bin/python3|python3|300"
     fi
 }
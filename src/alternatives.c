@@ -0,0 +1,325 @@
+/*
+ * switch - alternatives management tool for NurOS
+ * Copyright (C) 2026 AnmiTaliDev <anmitali198@gmail.com>
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+#define _DEFAULT_SOURCE
+
+#include "alternatives.h"
+#include <ctype.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define INITIAL_CAPACITY 32
+
+/* Fields of a record: path, name, priority, version */
+#define RECORD_FIELDS 4
+
+#define DEFAULT_PRIORITY 10
+
+void alternative_list_free(alternative_list_t *list)
+{
+    if (!list) {
+        return;
+    }
+
+    free(list->items);
+    free(list->storage);
+    memset(list, 0, sizeof(*list));
+}
+
+static int alternative_list_reserve(alternative_list_t *list)
+{
+    if (list->count < list->capacity) {
+        return 0;
+    }
+
+    size_t new_cap = list->capacity ? list->capacity * 2 : INITIAL_CAPACITY;
+    alternative_t *new_items = realloc(list->items, new_cap * sizeof(alternative_t));
+    if (!new_items) {
+        return -1;
+    }
+    list->items = new_items;
+    list->capacity = new_cap;
+    return 0;
+}
+
+/*
+ * Split a record in place at unescaped '|' and decode escapes. Returns the
+ * number of fields found (at most RECORD_FIELDS; the last one keeps any
+ * further separators).
+ */
+static size_t split_record(char *rec, size_t len, char *fields[RECORD_FIELDS])
+{
+    char *end = rec + len;
+    size_t n = 1;
+    fields[0] = rec;
+    *end = '\0';
+
+    /* Fast path: nothing escaped, fields end at each '|' */
+    if (!memchr(rec, '\\', len)) {
+        char *p = rec;
+        while (n < RECORD_FIELDS && (p = memchr(p, '|', (size_t)(end - p)))) {
+            *p++ = '\0';
+            fields[n++] = p;
+        }
+        return n;
+    }
+
+    char *dst = rec;
+    for (char *src = rec; src < end; src++) {
+        if (*src == '\\' && src + 1 < end) {
+            src++;
+            *dst++ = *src == 'n' ? '\n' : *src;
+        } else if (*src == '|' && n < RECORD_FIELDS) {
+            *dst++ = '\0';
+            fields[n++] = dst;
+        } else {
+            *dst++ = *src;
+        }
+    }
+    *dst = '\0';
+    return n;
+}
+
+static void add_record(alternative_list_t *list, char *rec, size_t len)
+{
+    char *fields[RECORD_FIELDS] = { NULL, NULL, NULL, NULL };
+    if (len == 0 || split_record(rec, len, fields) < 2) {
+        return;
+    }
+
+    if (alternative_list_reserve(list) != 0) {
+        return;
+    }
+
+    list->items[list->count].path = fields[0];
+    list->items[list->count].name = fields[1];
+    list->items[list->count].priority = fields[2] && *fields[2] ? atoi(fields[2])
+                                                                : DEFAULT_PRIORITY;
+    list->items[list->count].version = fields[3] && *fields[3] ? fields[3] : NULL;
+    list->count++;
+}
+
+/* Parse every record terminated by a newline */
+static void parse_complete(alternative_list_t *list)
+{
+    char *end = list->storage + list->storage_size;
+    char *rec = list->storage + list->parsed;
+    char *nl;
+
+    while (rec < end && (nl = memchr(rec, '\n', (size_t)(end - rec)))) {
+        add_record(list, rec, (size_t)(nl - rec));
+        rec = nl + 1;
+    }
+
+    list->parsed = (size_t)(rec - list->storage);
+}
+
+char *alternatives_buffer(alternative_list_t *list, size_t *avail)
+{
+    /* One byte stays spare to terminate a final unterminated record */
+    size_t needed = list->storage_size + ALTERNATIVES_READ_CHUNK + 1;
+    if (needed > list->storage_capacity) {
+        size_t new_capacity = list->storage_capacity ? list->storage_capacity * 2 : needed;
+        while (new_capacity < needed) {
+            new_capacity *= 2;
+        }
+
+        /* Views are rebased from offsets, since storage may move */
+        for (size_t i = 0; i < list->count; i++) {
+            alternative_t *alt = &list->items[i];
+            alt->path = (char *)(uintptr_t)(alt->path - list->storage);
+            alt->name = (char *)(uintptr_t)(alt->name - list->storage);
+            if (alt->version) {
+                alt->version = (char *)(uintptr_t)(alt->version - list->storage);
+            }
+        }
+
+        char *storage = realloc(list->storage, new_capacity);
+        if (storage) {
+            list->storage = storage;
+            list->storage_capacity = new_capacity;
+        }
+
+        for (size_t i = 0; i < list->count; i++) {
+            alternative_t *alt = &list->items[i];
+            alt->path = list->storage + (uintptr_t)alt->path;
+            alt->name = list->storage + (uintptr_t)alt->name;
+            if (alt->version) {
+                alt->version = list->storage + (uintptr_t)alt->version;
+            }
+        }
+
+        if (!storage) {
+            return NULL;
+        }
+    }
+
+    *avail = list->storage_capacity - list->storage_size - 1;
+    return list->storage + list->storage_size;
+}
+
+void alternatives_commit(alternative_list_t *list, size_t n)
+{
+    list->storage_size += n;
+    parse_complete(list);
+}
+
+int alternatives_feed(alternative_list_t *list, const char *data, size_t size)
+{
+    while (size > 0) {
+        size_t avail;
+        char *buf = alternatives_buffer(list, &avail);
+        if (!buf) {
+            return -1;
+        }
+
+        size_t n = size < avail ? size : avail;
+        memcpy(buf, data, n);
+        alternatives_commit(list, n);
+        data += n;
+        size -= n;
+    }
+    return 0;
+}
+
+void alternatives_finish(alternative_list_t *list)
+{
+    if (list->parsed < list->storage_size) {
+        add_record(list, list->storage + list->parsed,
+                   list->storage_size - list->parsed);
+        list->parsed = list->storage_size;
+    }
+}
+
+void alternatives_parse(alternative_list_t *list, char *buf, size_t size)
+{
+    list->storage = buf;
+    list->storage_size = size;
+    list->storage_capacity = size + 1;
+    list->parsed = 0;
+
+    parse_complete(list);
+    alternatives_finish(list);
+}
+
+static bool version_separator(char c)
+{
+    return c != '\0' && c != '~' && !isalnum((unsigned char)c);
+}
+
+int version_compare(const char *a, const char *b)
+{
+    for (;;) {
+        while (version_separator(*a)) {
+            a++;
+        }
+        while (version_separator(*b)) {
+            b++;
+        }
+
+        if (*a == '~' || *b == '~') {
+            if (*a != *b) {
+                return *a == '~' ? -1 : 1;
+            }
+            a++;
+            b++;
+            continue;
+        }
+
+        /* One ran out: a further number is newer, further letters older */
+        if (*a == '\0' || *b == '\0') {
+            if (*a == *b) {
+                return 0;
+            }
+            const char *rest = *a ? a : b;
+            int longer = isdigit((unsigned char)*rest) ? 1 : -1;
+            return *a ? longer : -longer;
+        }
+
+        bool digit_a = isdigit((unsigned char)*a);
+        bool digit_b = isdigit((unsigned char)*b);
+        if (digit_a != digit_b) {
+            return digit_a ? 1 : -1;
+        }
+
+        size_t len_a, len_b;
+        if (digit_a) {
+            /* Without leading zeros, the longer number is the larger */
+            while (*a == '0') {
+                a++;
+            }
+            while (*b == '0') {
+                b++;
+            }
+            len_a = strspn(a, "0123456789");
+            len_b = strspn(b, "0123456789");
+            if (len_a != len_b) {
+                return len_a < len_b ? -1 : 1;
+            }
+        } else {
+            for (len_a = 0; isalpha((unsigned char)a[len_a]); len_a++) {
+            }
+            for (len_b = 0; isalpha((unsigned char)b[len_b]); len_b++) {
+            }
+        }
+
+        int cmp = memcmp(a, b, len_a < len_b ? len_a : len_b);
+        if (cmp != 0) {
+            return cmp;
+        }
+        if (len_a != len_b) {
+            return len_a < len_b ? -1 : 1;
+        }
+        a += len_a;
+        b += len_b;
+    }
+}
+
+int alternative_compare(const alternative_t *a, const alternative_t *b)
+{
+    if (a->priority != b->priority) {
+        return a->priority < b->priority ? 1 : -1;
+    }
+    if (a->version && b->version) {
+        int cmp = version_compare(a->version, b->version);
+        if (cmp != 0) {
+            return -cmp;
+        }
+    } else if (a->version || b->version) {
+        return a->version ? -1 : 1;
+    }
+    return strcmp(a->name, b->name);
+}
+
+static int alternative_compare_qsort(const void *a, const void *b)
+{
+    return alternative_compare(a, b);
+}
+
+void alternatives_sort(alternative_list_t *list)
+{
+    if (list->count > 1) {
+        qsort(list->items, list->count, sizeof(alternative_t), alternative_compare_qsort);
+    }
+}
+
+const alternative_t *alternatives_best(const alternative_list_t *list)
+{
+    const alternative_t *best = NULL;
+    for (size_t i = 0; i < list->count; i++) {
+        if (!best || alternative_compare(&list->items[i], best) < 0) {
+            best = &list->items[i];
+        }
+    }
+    return best;
+}
@@ -0,0 +1,95 @@
+/*
+ * switch - alternatives management tool for NurOS
+ * Copyright (C) 2026 AnmiTaliDev <anmitali198@gmail.com>
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ */
+
+#ifndef SWITCH_ALTERNATIVES_H
+#define SWITCH_ALTERNATIVES_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/* Bytes the stream keeps free for each read into its buffer */
+#define ALTERNATIVES_READ_CHUNK (32 * 1024)
+
+/* Alternative entry */
+typedef struct {
+    char *path;      /* Full path to the binary */
+    char *name;      /* Display name */
+    int priority;    /* Priority (higher = preferred) */
+    char *version;   /* Version breaking priority ties, NULL if not given */
+} alternative_t;
+
+/*
+ * Alternatives list. path, name and version are views into storage, the single
+ * buffer holding the find_alternatives output.
+ */
+typedef struct {
+    alternative_t *items;
+    size_t count;
+    size_t capacity;
+    char *storage;
+    size_t storage_size;
+    size_t storage_capacity;
+    size_t parsed;      /* Bytes of storage consumed by complete records */
+} alternative_list_t;
+
+/* Free alternatives list */
+void alternative_list_free(alternative_list_t *list);
+
+/*
+ * Streaming parser for find_alternatives output. Records are lines of
+ * "path|name|priority" with an optional "|version"; an empty priority
+ * means the default of 10. Inside a field "\|", "\n" and "\\" stand for a
+ * literal '|', newline and backslash. Records are parsed as soon as their
+ * newline arrives.
+ *
+ * Return a pointer to at least ALTERNATIVES_READ_CHUNK free bytes at the
+ * end of the list's storage (growing it) and their number in *avail, or
+ * NULL on allocation failure. Views of parsed records are kept valid.
+ */
+char *alternatives_buffer(alternative_list_t *list, size_t *avail);
+
+/* Account for n bytes written into the buffer and parse complete records */
+void alternatives_commit(alternative_list_t *list, size_t n);
+
+/* Append a copy of data and parse complete records */
+int alternatives_feed(alternative_list_t *list, const char *data, size_t size);
+
+/* Parse a final record that lacks its newline */
+void alternatives_finish(alternative_list_t *list);
+
+/*
+ * Parse a complete output, taking ownership of buf (malloc'd, size bytes
+ * plus a terminating NUL). The list must be empty.
+ */
+void alternatives_parse(alternative_list_t *list, char *buf, size_t size);
+
+/*
+ * Compare version strings naturally: runs of digits numerically, runs of
+ * letters alphabetically, other characters only as separators. A number
+ * is newer than letters in the same place, a trailing letter run marks a
+ * pre-release ("6.8-rc1" < "6.8" < "6.8.1") and '~' sorts before
+ * anything. Returns <0, 0 or >0 like strcmp.
+ */
+int version_compare(const char *a, const char *b);
+
+/*
+ * Order of preference: higher priority first, then newer version (with a
+ * version before without), then by name. Returns <0 if a is preferred.
+ */
+int alternative_compare(const alternative_t *a, const alternative_t *b);
+
+/* Sort the list into order of preference */
+void alternatives_sort(alternative_list_t *list);
+
+/* Most preferred alternative, or NULL if the list is empty */
+const alternative_t *alternatives_best(const alternative_list_t *list);
+
+#endif /* SWITCH_ALTERNATIVES_H */
@@ -0,0 +1,80 @@
+/*
+ * switch - alternatives management tool for NurOS
+ * Copyright (C) 2026 AnmiTaliDev <anmitali198@gmail.com>
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ */
+
+#include "arena.h"
+#include <stdalign.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Default block size; larger requests get a block of their own */
+#define ARENA_BLOCK_SIZE (64 * 1024)
+
+struct arena_block {
+    arena_block_t *next;
+    size_t used;
+    size_t size;
+    alignas(max_align_t) unsigned char data[];
+};
+
+void *arena_alloc(arena_t *arena, size_t size)
+{
+    const size_t align = alignof(max_align_t);
+    size = (size + align - 1) & ~(align - 1);
+
+    arena_block_t *block = arena->head;
+    if (!block || block->size - block->used < size) {
+        size_t block_size = size > ARENA_BLOCK_SIZE ? size : ARENA_BLOCK_SIZE;
+        block = malloc(sizeof(arena_block_t) + block_size);
+        if (!block) {
+            return NULL;
+        }
+        block->used = 0;
+        block->size = block_size;
+
+        /* Keep filling the current block if the new one is a one-off */
+        if (arena->head && size > ARENA_BLOCK_SIZE) {
+            block->next = arena->head->next;
+            arena->head->next = block;
+        } else {
+            block->next = arena->head;
+            arena->head = block;
+        }
+    }
+
+    void *ptr = block->data + block->used;
+    block->used += size;
+    return ptr;
+}
+
+char *arena_strdup(arena_t *arena, const char *s)
+{
+    if (!s) {
+        return NULL;
+    }
+
+    size_t len = strlen(s) + 1;
+    char *copy = arena_alloc(arena, len);
+    if (copy) {
+        memcpy(copy, s, len);
+    }
+    return copy;
+}
+
+void arena_free(arena_t *arena)
+{
+    arena_block_t *block = arena->head;
+    while (block) {
+        arena_block_t *next = block->next;
+        free(block);
+        block = next;
+    }
+    arena->head = NULL;
+}
@@ -0,0 +1,33 @@
+/*
+ * switch - alternatives management tool for NurOS
+ * Copyright (C) 2026 AnmiTaliDev <anmitali198@gmail.com>
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ */
+
+#ifndef SWITCH_ARENA_H
+#define SWITCH_ARENA_H
+
+#include <stddef.h>
+
+typedef struct arena_block arena_block_t;
+
+/* Bump allocator; everything it hands out is released by arena_free() */
+typedef struct {
+    arena_block_t *head;
+} arena_t;
+
+/* Allocate size bytes aligned for any scalar type, or NULL */
+void *arena_alloc(arena_t *arena, size_t size);
+
+/* Copy s into the arena; NULL stays NULL */
+char *arena_strdup(arena_t *arena, const char *s);
+
+/* Release every allocation at once */
+void arena_free(arena_t *arena);
+
+#endif /* SWITCH_ARENA_H */
@@ -0,0 +1,636 @@
+/*
+ * switch - alternatives management tool for NurOS
+ * Copyright (C) 2026 AnmiTaliDev <anmitali198@gmail.com>
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+#define _DEFAULT_SOURCE
+
+#include "cache.h"
+#include "utils.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+
+#define CACHE_FILE_NAME "metadata.cache"
+#define CACHE_LOCK_NAME "metadata.lock"
+#define CACHE_MAGIC 0x434d5753u    /* "SWMC" */
+#define CACHE_VERSION 1u
+#define CACHE_NO_STRING UINT32_MAX
+#define STAMPED_MAGIC 0x43415753u  /* "SWAC" */
+
+/*
+ * File layout: header, entries sorted by path, string table. Strings are
+ * NUL-terminated and referenced by offset from the start of the table.
+ */
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t value_count;
+    uint32_t entry_count;
+    uint64_t strings_size;
+} cache_header_t;
+
+typedef struct {
+    cache_key_t key;
+    uint32_t path;
+    uint32_t values[CACHE_MAX_VALUES];
+} cache_entry_t;
+
+/* Header of a stamped cache file, followed by the stamps and the data */
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t stamp_count;
+    uint32_t reserved;
+    uint64_t data_size;
+} stamped_header_t;
+
+/* Entry view used while merging and writing */
+typedef struct {
+    const char *path;
+    const cache_key_t *key;
+    const char *values[CACHE_MAX_VALUES];
+    size_t order;           /* Store order, newest first after sorting */
+} cache_record_t;
+
+void cache_key_from_stat(cache_key_t *key, const struct stat *st)
+{
+    memset(key, 0, sizeof(*key));
+    key->dev = (uint64_t)st->st_dev;
+    key->ino = (uint64_t)st->st_ino;
+    key->mtime_sec = (int64_t)st->st_mtim.tv_sec;
+    key->mtime_nsec = (int64_t)st->st_mtim.tv_nsec;
+    key->size = (int64_t)st->st_size;
+}
+
+static bool cache_key_equal(const cache_key_t *a, const cache_key_t *b)
+{
+    return a->dev == b->dev && a->ino == b->ino &&
+           a->mtime_sec == b->mtime_sec && a->mtime_nsec == b->mtime_nsec &&
+           a->size == b->size;
+}
+
+static char *path_join(const char *dir, const char *name)
+{
+    size_t len = strlen(dir) + 1 + strlen(name) + 1;
+    char *path = malloc(len);
+    if (path) {
+        snprintf(path, len, "%s/%s", dir, name);
+    }
+    return path;
+}
+
+/* Validate a mapping and return its header, or NULL */
+static const cache_header_t *cache_header(const void *map, size_t size,
+                                          size_t value_count)
+{
+    if (!map || size < sizeof(cache_header_t)) {
+        return NULL;
+    }
+
+    const cache_header_t *header = map;
+    if (header->magic != CACHE_MAGIC || header->version != CACHE_VERSION ||
+        header->value_count != value_count) {
+        return NULL;
+    }
+
+    uint64_t need = sizeof(*header) +
+                    (uint64_t)header->entry_count * sizeof(cache_entry_t) +
+                    header->strings_size;
+    if (need != size) {
+        return NULL;
+    }
+
+    return header;
+}
+
+static const cache_entry_t *cache_entries(const cache_header_t *header)
+{
+    return (const cache_entry_t *)(header + 1);
+}
+
+static const char *cache_string(const cache_header_t *header, uint32_t offset)
+{
+    if (offset == CACHE_NO_STRING || offset >= header->strings_size) {
+        return NULL;
+    }
+
+    const char *table = (const char *)(cache_entries(header) + header->entry_count);
+    if (!memchr(table + offset, '\0', header->strings_size - offset)) {
+        return NULL;
+    }
+    return table + offset;
+}
+
+static void *map_file(const char *path, size_t *size)
+{
+    *size = 0;
+
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd == -1) {
+        return NULL;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size <= 0) {
+        close(fd);
+        return NULL;
+    }
+
+    void *map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        return NULL;
+    }
+
+    *size = (size_t)st.st_size;
+    return map;
+}
+
+int metadata_cache_open(metadata_cache_t *cache, const char *dir, size_t value_count)
+{
+    if (!cache || !dir || value_count > CACHE_MAX_VALUES) {
+        return -1;
+    }
+
+    memset(cache, 0, sizeof(*cache));
+    cache->value_count = value_count;
+    cache->dir = strdup(dir);
+    cache->file = path_join(dir, CACHE_FILE_NAME);
+    if (!cache->dir || !cache->file) {
+        metadata_cache_close(cache);
+        return -1;
+    }
+
+    cache->map = map_file(cache->file, &cache->map_size);
+    if (cache->map && !cache_header(cache->map, cache->map_size, value_count)) {
+        munmap(cache->map, cache->map_size);
+        cache->map = NULL;
+        cache->map_size = 0;
+    }
+
+    return 0;
+}
+
+/* Binary search for path in a validated mapping */
+static const cache_entry_t *cache_find(const cache_header_t *header, const char *path)
+{
+    const cache_entry_t *entries = cache_entries(header);
+    size_t lo = 0;
+    size_t hi = header->entry_count;
+
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        const char *entry_path = cache_string(header, entries[mid].path);
+        if (!entry_path) {
+            return NULL;
+        }
+
+        int cmp = strcmp(path, entry_path);
+        if (cmp == 0) {
+            return &entries[mid];
+        }
+        if (cmp < 0) {
+            hi = mid;
+        } else {
+            lo = mid + 1;
+        }
+    }
+
+    return NULL;
+}
+
+bool metadata_cache_lookup(metadata_cache_t *cache, const char *path,
+                           const cache_key_t *key, char **values)
+{
+    if (!cache || !path || !key) {
+        return false;
+    }
+
+    const cache_header_t *header = cache_header(cache->map, cache->map_size,
+                                                cache->value_count);
+    const cache_entry_t *entry = header ? cache_find(header, path) : NULL;
+
+    if (!entry || !cache_key_equal(&entry->key, key)) {
+        cache->misses++;
+        return false;
+    }
+
+    for (size_t i = 0; i < cache->value_count; i++) {
+        const char *value = cache_string(header, entry->values[i]);
+        values[i] = value ? strdup(value) : NULL;
+    }
+
+    cache->hits++;
+    return true;
+}
+
+int metadata_cache_store(metadata_cache_t *cache, const char *path,
+                         const cache_key_t *key, char *const *values)
+{
+    if (!cache || !path || !key) {
+        return -1;
+    }
+
+    if (cache->pending_count >= cache->pending_capacity) {
+        size_t new_capacity = cache->pending_capacity ? cache->pending_capacity * 2 : 16;
+        cache_pending_t *new_pending = realloc(cache->pending,
+                                               new_capacity * sizeof(cache_pending_t));
+        if (!new_pending) {
+            return -1;
+        }
+        cache->pending = new_pending;
+        cache->pending_capacity = new_capacity;
+    }
+
+    cache_pending_t *entry = &cache->pending[cache->pending_count];
+    memset(entry, 0, sizeof(*entry));
+    entry->path = strdup(path);
+    entry->key = *key;
+    if (!entry->path) {
+        return -1;
+    }
+
+    for (size_t i = 0; i < cache->value_count; i++) {
+        if (values[i] && !(entry->values[i] = strdup(values[i]))) {
+            for (size_t j = 0; j < i; j++) {
+                free(entry->values[j]);
+            }
+            free(entry->path);
+            return -1;
+        }
+    }
+
+    cache->pending_count++;
+    return 0;
+}
+
+static int record_path_compare(const void *a, const void *b)
+{
+    const cache_record_t *ra = a;
+    const cache_record_t *rb = b;
+    return strcmp(ra->path, rb->path);
+}
+
+static int record_compare(const void *a, const void *b)
+{
+    const cache_record_t *ra = a;
+    const cache_record_t *rb = b;
+    int cmp = record_path_compare(a, b);
+    if (cmp != 0) {
+        return cmp;
+    }
+    return (ra->order < rb->order) - (ra->order > rb->order);
+}
+
+/* True if the entry still describes the file at its path */
+static bool record_is_current(const cache_record_t *record)
+{
+    struct stat st;
+    if (stat(record->path, &st) != 0) {
+        return false;
+    }
+
+    cache_key_t key;
+    cache_key_from_stat(&key, &st);
+    return cache_key_equal(&key, record->key);
+}
+
+/* Serialize sorted records into a newly allocated buffer */
+static void *cache_serialize(const cache_record_t *records, size_t count,
+                             size_t value_count, size_t *out_size)
+{
+    uint64_t strings_size = 0;
+    for (size_t i = 0; i < count; i++) {
+        strings_size += strlen(records[i].path) + 1;
+        for (size_t j = 0; j < value_count; j++) {
+            if (records[i].values[j]) {
+                strings_size += strlen(records[i].values[j]) + 1;
+            }
+        }
+    }
+
+    if (strings_size >= CACHE_NO_STRING) {
+        return NULL;
+    }
+
+    size_t size = sizeof(cache_header_t) + count * sizeof(cache_entry_t) + strings_size;
+    char *buf = calloc(1, size);
+    if (!buf) {
+        return NULL;
+    }
+
+    cache_header_t *header = (cache_header_t *)buf;
+    header->magic = CACHE_MAGIC;
+    header->version = CACHE_VERSION;
+    header->value_count = (uint32_t)value_count;
+    header->entry_count = (uint32_t)count;
+    header->strings_size = strings_size;
+
+    cache_entry_t *entries = (cache_entry_t *)(header + 1);
+    char *table = (char *)(entries + count);
+    uint32_t offset = 0;
+
+    for (size_t i = 0; i < count; i++) {
+        entries[i].key = *records[i].key;
+
+        size_t len = strlen(records[i].path) + 1;
+        memcpy(table + offset, records[i].path, len);
+        entries[i].path = offset;
+        offset += (uint32_t)len;
+
+        for (size_t j = 0; j < CACHE_MAX_VALUES; j++) {
+            const char *value = j < value_count ? records[i].values[j] : NULL;
+            if (!value) {
+                entries[i].values[j] = CACHE_NO_STRING;
+                continue;
+            }
+            len = strlen(value) + 1;
+            memcpy(table + offset, value, len);
+            entries[i].values[j] = offset;
+            offset += (uint32_t)len;
+        }
+    }
+
+    *out_size = size;
+    return buf;
+}
+
+int metadata_cache_flush(metadata_cache_t *cache)
+{
+    if (!cache || cache->pending_count == 0) {
+        return 0;
+    }
+
+    if (make_dirs(cache->dir, 0700) != 0) {
+        return -1;
+    }
+
+    /* Serialize writers so concurrent updates merge instead of racing */
+    char *lock_path = path_join(cache->dir, CACHE_LOCK_NAME);
+    if (!lock_path) {
+        return -1;
+    }
+    int lock_fd = open(lock_path, O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+    free(lock_path);
+    if (lock_fd == -1) {
+        return -1;
+    }
+    while (flock(lock_fd, LOCK_EX) != 0) {
+        if (errno != EINTR) {
+            close(lock_fd);
+            return -1;
+        }
+    }
+
+    /* Re-read the file: another process may have replaced it */
+    size_t map_size = 0;
+    void *map = map_file(cache->file, &map_size);
+    const cache_header_t *header = cache_header(map, map_size, cache->value_count);
+    size_t existing = header ? header->entry_count : 0;
+
+    int ret = -1;
+    cache_record_t *records = calloc(cache->pending_count + existing + 1,
+                                     sizeof(cache_record_t));
+    if (!records) {
+        goto out;
+    }
+
+    /* Pending entries are newest last; keep only the latest per path */
+    size_t count = 0;
+    for (size_t i = 0; i < cache->pending_count; i++) {
+        cache_pending_t *pending = &cache->pending[i];
+        cache_record_t *record = &records[count++];
+        record->path = pending->path;
+        record->key = &pending->key;
+        record->order = i;
+        for (size_t j = 0; j < cache->value_count; j++) {
+            record->values[j] = pending->values[j];
+        }
+    }
+    qsort(records, count, sizeof(*records), record_compare);
+
+    size_t unique = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (unique && strcmp(records[unique - 1].path, records[i].path) == 0) {
+            continue;
+        }
+        records[unique++] = records[i];
+    }
+    count = unique;
+
+    size_t fresh = count;
+    const cache_entry_t *entries = header ? cache_entries(header) : NULL;
+    for (size_t i = 0; i < existing; i++) {
+        cache_record_t record = {
+            .path = cache_string(header, entries[i].path),
+            .key = &entries[i].key,
+        };
+        if (!record.path ||
+            bsearch(&record, records, fresh, sizeof(*records), record_path_compare) ||
+            !record_is_current(&record)) {
+            continue;
+        }
+        for (size_t j = 0; j < cache->value_count; j++) {
+            record.values[j] = cache_string(header, entries[i].values[j]);
+        }
+        records[count++] = record;
+    }
+
+    qsort(records, count, sizeof(*records), record_path_compare);
+
+    size_t size = 0;
+    void *data = cache_serialize(records, count, cache->value_count, &size);
+    if (data) {
+        ret = cache_write_atomic(cache->dir, CACHE_FILE_NAME, data, size);
+        free(data);
+    }
+    free(records);
+
+out:
+    if (map) {
+        munmap(map, map_size);
+    }
+    flock(lock_fd, LOCK_UN);
+    close(lock_fd);
+    return ret;
+}
+
+void metadata_cache_close(metadata_cache_t *cache)
+{
+    if (!cache) {
+        return;
+    }
+
+    for (size_t i = 0; i < cache->pending_count; i++) {
+        free(cache->pending[i].path);
+        for (size_t j = 0; j < CACHE_MAX_VALUES; j++) {
+            free(cache->pending[i].values[j]);
+        }
+    }
+    free(cache->pending);
+
+    if (cache->map) {
+        munmap(cache->map, cache->map_size);
+    }
+
+    free(cache->dir);
+    free(cache->file);
+    memset(cache, 0, sizeof(*cache));
+}
+
+int cache_write_atomic(const char *dir, const char *name,
+                       const void *data, size_t size)
+{
+    if (!dir || !name || (!data && size)) {
+        return -1;
+    }
+
+    if (make_dirs(dir, 0700) != 0) {
+        return -1;
+    }
+
+    size_t len = strlen(dir) + strlen(name) + 16;
+    char *tmp = malloc(len);
+    char *target = path_join(dir, name);
+    if (!tmp || !target) {
+        free(tmp);
+        free(target);
+        return -1;
+    }
+    snprintf(tmp, len, "%s/.%s.XXXXXX", dir, name);
+
+    int fd = mkstemp(tmp);
+    if (fd == -1) {
+        free(tmp);
+        free(target);
+        return -1;
+    }
+
+    const char *p = data;
+    size_t left = size;
+    while (left > 0) {
+        ssize_t n = write(fd, p, left);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            break;
+        }
+        p += n;
+        left -= (size_t)n;
+    }
+
+    int ret = -1;
+    if (close(fd) == 0 && left == 0 && rename(tmp, target) == 0) {
+        ret = 0;
+    } else {
+        unlink(tmp);
+    }
+
+    free(tmp);
+    free(target);
+    return ret;
+}
+
+void cache_stamp_path(const char *path, cache_key_t *key)
+{
+    struct stat st;
+    if (!path || stat(path, &st) != 0) {
+        memset(key, 0, sizeof(*key));
+        return;
+    }
+    cache_key_from_stat(key, &st);
+}
+
+char *stamped_cache_read(const char *dir, const char *name,
+                         const cache_key_t *stamps, size_t stamp_count,
+                         size_t *size)
+{
+    if (!dir || !name || !stamps) {
+        return NULL;
+    }
+
+    char *path = path_join(dir, name);
+    if (!path) {
+        return NULL;
+    }
+
+    size_t map_size = 0;
+    void *map = map_file(path, &map_size);
+    free(path);
+    if (!map) {
+        return NULL;
+    }
+
+    char *data = NULL;
+    const stamped_header_t *header = map;
+    size_t stamps_size = stamp_count * sizeof(cache_key_t);
+
+    if (map_size < sizeof(*header) ||
+        header->magic != STAMPED_MAGIC || header->version != CACHE_VERSION ||
+        header->stamp_count != stamp_count ||
+        map_size != sizeof(*header) + stamps_size + header->data_size) {
+        goto out;
+    }
+
+    const cache_key_t *stored = (const cache_key_t *)(header + 1);
+    for (size_t i = 0; i < stamp_count; i++) {
+        if (!cache_key_equal(&stored[i], &stamps[i])) {
+            goto out;
+        }
+    }
+
+    data = malloc(header->data_size + 1);
+    if (data) {
+        memcpy(data, (const char *)(stored + stamp_count), header->data_size);
+        data[header->data_size] = '\0';
+        *size = header->data_size;
+    }
+
+out:
+    munmap(map, map_size);
+    return data;
+}
+
+int stamped_cache_write(const char *dir, const char *name,
+                        const cache_key_t *stamps, size_t stamp_count,
+                        const void *data, size_t size)
+{
+    if (!dir || !name || !stamps || (!data && size)) {
+        return -1;
+    }
+
+    size_t stamps_size = stamp_count * sizeof(cache_key_t);
+    size_t total = sizeof(stamped_header_t) + stamps_size + size;
+    char *buf = calloc(1, total);
+    if (!buf) {
+        return -1;
+    }
+
+    stamped_header_t *header = (stamped_header_t *)buf;
+    header->magic = STAMPED_MAGIC;
+    header->version = CACHE_VERSION;
+    header->stamp_count = (uint32_t)stamp_count;
+    header->data_size = size;
+    memcpy(header + 1, stamps, stamps_size);
+    if (size) {
+        memcpy(buf + sizeof(*header) + stamps_size, data, size);
+    }
+
+    int ret = cache_write_atomic(dir, name, buf, total);
+    free(buf);
+    return ret;
+}
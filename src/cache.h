@@ -0,0 +1,99 @@
+/*
+ * switch - alternatives management tool for NurOS
+ * Copyright (C) 2026 AnmiTaliDev <anmitali198@gmail.com>
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ */
+
+#ifndef SWITCH_CACHE_H
+#define SWITCH_CACHE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/stat.h>
+
+/* Maximum number of values stored per cache entry */
+#define CACHE_MAX_VALUES 11
+
+/* File identity a cache entry is valid for */
+typedef struct {
+    uint64_t dev;
+    uint64_t ino;
+    int64_t mtime_sec;
+    int64_t mtime_nsec;
+    int64_t size;
+} cache_key_t;
+
+/* Entry added during this run, written back by metadata_cache_flush() */
+typedef struct {
+    char *path;
+    cache_key_t key;
+    char *values[CACHE_MAX_VALUES];
+} cache_pending_t;
+
+/* Persistent metadata cache */
+typedef struct {
+    char *dir;              /* Cache directory */
+    char *file;             /* Path of the cache file */
+    size_t value_count;     /* Values per entry */
+    void *map;              /* Read-only mapping of the cache file */
+    size_t map_size;
+    cache_pending_t *pending;
+    size_t pending_count;
+    size_t pending_capacity;
+    unsigned hits;
+    unsigned misses;
+} metadata_cache_t;
+
+/* Build a cache key from stat data */
+void cache_key_from_stat(cache_key_t *key, const struct stat *st);
+
+/* Open the cache stored in dir; a missing or invalid file is an empty cache */
+int metadata_cache_open(metadata_cache_t *cache, const char *dir, size_t value_count);
+
+/*
+ * Look up path. On a hit the values are duplicated into values[] (NULL for
+ * unset) and true is returned.
+ */
+bool metadata_cache_lookup(metadata_cache_t *cache, const char *path,
+                           const cache_key_t *key, char **values);
+
+/* Record values for path; they are written on the next flush */
+int metadata_cache_store(metadata_cache_t *cache, const char *path,
+                         const cache_key_t *key, char *const *values);
+
+/* Merge pending entries into the cache file and replace it atomically */
+int metadata_cache_flush(metadata_cache_t *cache);
+
+/* Release the cache (pending entries are discarded) */
+void metadata_cache_close(metadata_cache_t *cache);
+
+/* Stamp path for invalidation; a missing path yields an all-zero stamp */
+void cache_stamp_path(const char *path, cache_key_t *key);
+
+/*
+ * Read dir/name if it was written with exactly the given stamps. Returns a
+ * NUL-terminated buffer (size excludes the terminator) or NULL on a miss.
+ */
+char *stamped_cache_read(const char *dir, const char *name,
+                         const cache_key_t *stamps, size_t stamp_count,
+                         size_t *size);
+
+/* Store data in dir/name together with the stamps it is valid for */
+int stamped_cache_write(const char *dir, const char *name,
+                        const cache_key_t *stamps, size_t stamp_count,
+                        const void *data, size_t size);
+
+/*
+ * Write data to dir/name through a temporary file and rename(), creating
+ * dir if needed. Readers observe either the old or the new contents.
+ */
+int cache_write_atomic(const char *dir, const char *name,
+                       const void *data, size_t size);
+
+#endif /* SWITCH_CACHE_H */
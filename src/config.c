@@ -13,11 +13,15 @@
 #define _DEFAULT_SOURCE
 
 #include "config.h"
+#include "utils.h"
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
+#include <stdint.h>
+#include <errno.h>
 #include <unistd.h>
 #include <pwd.h>
+#include <sys/stat.h>
 
 const char *config_get_home(void)
 {
@@ -65,9 +69,128 @@ int config_init(switch_config_t *config)
         return -1;
     }
 
+    /* Cache directory */
+    const char *cache_home = getenv("XDG_CACHE_HOME");
+    if (cache_home && cache_home[0] == '/') {
+        size_t len = strlen(cache_home) + 1 + strlen(SWITCH_CACHE_SUBDIR) + 1;
+        config->cache_dir = malloc(len);
+        if (config->cache_dir) {
+            snprintf(config->cache_dir, len, "%s/%s", cache_home, SWITCH_CACHE_SUBDIR);
+        }
+    } else if (home) {
+        size_t len = strlen(home) + strlen("/.cache/") + strlen(SWITCH_CACHE_SUBDIR) + 1;
+        config->cache_dir = malloc(len);
+        if (config->cache_dir) {
+            snprintf(config->cache_dir, len, "%s/.cache/%s", home, SWITCH_CACHE_SUBDIR);
+        }
+    }
+
+    /* switchd socket */
+    const char *runtime_dir = getenv("XDG_RUNTIME_DIR");
+    if (runtime_dir && runtime_dir[0] == '/') {
+        size_t len = strlen(runtime_dir) + 1 + strlen(SWITCH_SOCKET_NAME) + 1;
+        config->socket_path = malloc(len);
+        if (config->socket_path) {
+            snprintf(config->socket_path, len, "%s/%s", runtime_dir, SWITCH_SOCKET_NAME);
+        }
+    }
+
     /* Color enabled by default */
     config->color_enabled = true;
 
+    /* One module evaluation per CPU by default */
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    config->jobs = cpus > 0 ? (int)cpus : 1;
+
+    /* Module evaluations may run as long as they like unless limited */
+    const char *timeout = getenv("SWITCH_TIMEOUT");
+    if (timeout && *timeout && config_parse_timeout(timeout, &config->timeout_ms) != 0) {
+        print_warning("Ignoring invalid SWITCH_TIMEOUT '%s'", timeout);
+    }
+
+    return 0;
+}
+
+/* Replace *path with before + *path + after; NULL stays NULL */
+static int config_wrap(char **path, const char *before, const char *after)
+{
+    if (!*path) {
+        return 0;
+    }
+
+    size_t len = strlen(before) + strlen(*path) + strlen(after) + 1;
+    char *joined = malloc(len);
+    if (!joined) {
+        return -1;
+    }
+    snprintf(joined, len, "%s%s%s", before, *path, after);
+    free(*path);
+    *path = joined;
+    return 0;
+}
+
+int config_set_root(switch_config_t *config, const char *root)
+{
+    if (!config || !root) {
+        return -1;
+    }
+
+    char *resolved = realpath(root, NULL);
+    struct stat st;
+    if (!resolved || stat(resolved, &st) != 0 || !S_ISDIR(st.st_mode)) {
+        print_error("Invalid root %s: %s", root,
+                    resolved ? strerror(ENOTDIR) : strerror(errno));
+        free(resolved);
+        return -1;
+    }
+
+    /* "/" is the running system */
+    if (strcmp(resolved, "/") == 0) {
+        free(resolved);
+        return 0;
+    }
+
+    /* One cache per root, so images never see each other's results */
+    char hash[17];
+    uint64_t h = 0xcbf29ce484222325u;
+    for (const unsigned char *p = (const unsigned char *)resolved; *p; p++) {
+        h = (h ^ *p) * 0x100000001b3u;
+    }
+    snprintf(hash, sizeof(hash), "%016llx", (unsigned long long)h);
+
+    char sub[sizeof("/roots/") + sizeof(hash)];
+    snprintf(sub, sizeof(sub), "/roots/%s", hash);
+
+    if (config_wrap(&config->system_modules_dir, resolved, "") != 0 ||
+        config_wrap(&config->user_modules_dir, resolved, "") != 0 ||
+        config_wrap(&config->config_dir, resolved, "") != 0 ||
+        config_wrap(&config->cache_dir, "", sub) != 0) {
+        free(resolved);
+        return -1;
+    }
+
+    /* switchd serves the running system only */
+    free(config->socket_path);
+    config->socket_path = NULL;
+
+    free(config->root);
+    config->root = resolved;
+    return 0;
+}
+
+int config_parse_timeout(const char *text, int *timeout_ms)
+{
+    char *end;
+    errno = 0;
+    double seconds = strtod(text, &end);
+    if (*text == '\0' || *end != '\0' || errno != 0 ||
+        !(seconds >= 0 && seconds <= 86400)) {
+        return -1;
+    }
+
+    /* A positive timeout never rounds down to "none" */
+    int ms = (int)(seconds * 1000 + 0.5);
+    *timeout_ms = seconds > 0 && ms == 0 ? 1 : ms;
     return 0;
 }
 
@@ -80,6 +203,9 @@ void config_free(switch_config_t *config)
     free(config->system_modules_dir);
     free(config->user_modules_dir);
     free(config->config_dir);
+    free(config->cache_dir);
+    free(config->socket_path);
+    free(config->root);
 
     memset(config, 0, sizeof(*config));
 }
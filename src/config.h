@@ -35,12 +35,25 @@
 /* User modules directory (relative to HOME) */
 #define SWITCH_USER_MODULES_DIR ".local/share/switch/modules"
 
+/* Cache directory (relative to XDG_CACHE_HOME, or HOME/.cache) */
+#define SWITCH_CACHE_SUBDIR "switch"
+
+/* switchd socket (relative to XDG_RUNTIME_DIR) */
+#define SWITCH_SOCKET_NAME "switch/switchd.sock"
+
 /* Configuration structure */
 typedef struct {
     char *system_modules_dir;
     char *user_modules_dir;
     char *config_dir;
+    char *cache_dir;
+    char *socket_path;      /* switchd socket, NULL without XDG_RUNTIME_DIR */
+    char *root;             /* Image tree managed with --root, NULL for "/" */
     bool color_enabled;
+    bool refresh;           /* Ignore cached alternatives */
+    bool sort_alternatives; /* Buffer list output and order it by priority */
+    int jobs;               /* Concurrent module evaluations */
+    int timeout_ms;         /* Limit for one module evaluation, 0 for none */
 } switch_config_t;
 
 /* Initialize configuration */
@@ -49,6 +62,20 @@ int config_init(switch_config_t *config);
 /* Free configuration resources */
 void config_free(switch_config_t *config);
 
+/*
+ * Manage the image tree at root instead of the running system: module
+ * directories are looked up inside it, cached results are kept apart from
+ * the host's and switchd is not used. Returns -1 if root is not a
+ * directory.
+ */
+int config_set_root(switch_config_t *config, const char *root);
+
+/*
+ * Parse a timeout in seconds ("30", "2.5"; "0" for none) into
+ * milliseconds. Returns -1 if text is not a valid timeout.
+ */
+int config_parse_timeout(const char *text, int *timeout_ms);
+
 /* Get user home directory */
 const char *config_get_home(void);
 
@@ -0,0 +1,327 @@
+/*
+ * switch - alternatives management tool for NurOS
+ * Copyright (C) 2026 AnmiTaliDev <anmitali198@gmail.com>
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+#define _DEFAULT_SOURCE
+
+#include "dump.h"
+#include "alternatives.h"
+#include "pathid.h"
+#include "trace.h"
+#include "utils.h"
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+/* A managed link and where it points now */
+typedef struct {
+    char *path;
+    char *target;           /* readlink() result, NULL if not a symlink */
+    const char *resolved;   /* Final target, NULL if it does not resolve */
+} dump_link_t;
+
+/* State of one module as dumped */
+typedef struct {
+    const module_info_t *module;
+    alternative_list_t alts;
+    bool has_alts;          /* False if its alternatives could not be loaded */
+    dump_link_t *links;     /* Managed link first, then the extra links */
+    size_t link_count;
+    const alternative_t *current;   /* Alternative the link points to */
+} dump_entry_t;
+
+int dump_parse_format(const char *name, dump_format_t *format)
+{
+    if (strcmp(name, "json") == 0) {
+        *format = DUMP_JSON;
+    } else if (strcmp(name, "nul") == 0) {
+        *format = DUMP_NUL;
+    } else {
+        return -1;
+    }
+    return 0;
+}
+
+static char *read_link(const char *path)
+{
+    struct stat st;
+    if (path_stat(path, &st, false) != 0 || !S_ISLNK(st.st_mode)) {
+        return NULL;
+    }
+
+    size_t size = st.st_size > 0 ? (size_t)st.st_size + 1 : 4096;
+    char *buf = malloc(size);
+    ssize_t len = buf ? path_readlink(path, buf, size) : -1;
+    if (len < 0 || (size_t)len >= size) {
+        free(buf);
+        return NULL;
+    }
+    buf[len] = '\0';
+    return buf;
+}
+
+static void dump_link_add(dump_entry_t *entry, const char *path, size_t len)
+{
+    dump_link_t *link = &entry->links[entry->link_count];
+    link->path = strndup(path, len);
+    if (!link->path) {
+        return;
+    }
+    link->target = read_link(link->path);
+    link->resolved = link->target ? path_resolved(link->path) : NULL;
+    entry->link_count++;
+}
+
+static void dump_entry_load(dump_entry_t *entry, const module_info_t *module)
+{
+    memset(entry, 0, sizeof(*entry));
+    entry->module = module;
+
+    /* Memoized by module_load_all_alternatives(); NULL if evaluation failed */
+    if (module->alternatives) {
+        char *copy = strdup(module->alternatives);
+        if (copy) {
+            alternatives_parse(&entry->alts, copy, strlen(copy));
+            entry->has_alts = true;
+        }
+    }
+
+    if (!module->link_path) {
+        return;
+    }
+
+    size_t count = 1;
+    for (const char *p = module->extra_links; p && *p; p++) {
+        count += *p == ':';
+    }
+    count += module->extra_links ? 1 : 0;
+    entry->links = calloc(count, sizeof(dump_link_t));
+    if (!entry->links) {
+        return;
+    }
+
+    dump_link_add(entry, module->link_path, strlen(module->link_path));
+    for (const char *p = module->extra_links; p && *p;) {
+        size_t len = strcspn(p, ":");
+        if (len) {
+            dump_link_add(entry, p, len);
+        }
+        p += len + (p[len] == ':');
+    }
+
+    /* Same file as the link's target, however either path is spelled */
+    path_id_t current;
+    if (entry->link_count && entry->links[0].target &&
+        path_identity(entry->links[0].path, &current)) {
+        for (size_t i = 0; i < entry->alts.count && !entry->current; i++) {
+            path_id_t id;
+            if (path_identity(entry->alts.items[i].path, &id) &&
+                path_id_equal(&id, &current)) {
+                entry->current = &entry->alts.items[i];
+            }
+        }
+    }
+}
+
+static void dump_entry_free(dump_entry_t *entry)
+{
+    for (size_t i = 0; i < entry->link_count; i++) {
+        free(entry->links[i].path);
+        free(entry->links[i].target);
+    }
+    free(entry->links);
+    alternative_list_free(&entry->alts);
+}
+
+/* JSON string, or null; bytes that are not ASCII are passed through */
+static void json_string(FILE *fp, const char *s)
+{
+    if (!s) {
+        fputs("null", fp);
+        return;
+    }
+
+    fputc('"', fp);
+    for (const unsigned char *p = (const unsigned char *)s; *p; p++) {
+        switch (*p) {
+        case '"':
+            fputs("\\\"", fp);
+            break;
+        case '\\':
+            fputs("\\\\", fp);
+            break;
+        case '\n':
+            fputs("\\n", fp);
+            break;
+        case '\t':
+            fputs("\\t", fp);
+            break;
+        default:
+            if (*p < 0x20) {
+                fprintf(fp, "\\u%04x", *p);
+            } else {
+                fputc(*p, fp);
+            }
+        }
+    }
+    fputc('"', fp);
+}
+
+static void json_key(FILE *fp, const char *key, const char *value)
+{
+    fprintf(fp, "\"%s\":", key);
+    json_string(fp, value);
+}
+
+static void dump_json_entry(FILE *fp, const dump_entry_t *entry)
+{
+    const module_info_t *m = entry->module;
+
+    fputc('{', fp);
+    json_key(fp, "name", m->name);
+    fputc(',', fp);
+    json_key(fp, "path", m->path);
+    fprintf(fp, ",\"user\":%s,\"declarative\":%s,",
+            m->is_user ? "true" : "false", m->declarative ? "true" : "false");
+    json_key(fp, "description", m->description);
+    fputc(',', fp);
+    json_key(fp, "category", m->category);
+    fputc(',', fp);
+    json_key(fp, "watch", m->watch);
+
+    fputs(",\"links\":[", fp);
+    for (size_t i = 0; i < entry->link_count; i++) {
+        const dump_link_t *link = &entry->links[i];
+        fputs(i ? ",{" : "{", fp);
+        json_key(fp, "path", link->path);
+        fprintf(fp, ",\"extra\":%s,", i ? "true" : "false");
+        json_key(fp, "target", link->target);
+        fputc(',', fp);
+        json_key(fp, "resolved", link->resolved);
+        fputc('}', fp);
+    }
+    fputs("],", fp);
+
+    json_key(fp, "current", entry->current ? entry->current->name : NULL);
+
+    fputs(",\"alternatives\":", fp);
+    if (!entry->has_alts) {
+        fputs("null", fp);
+    } else {
+        fputc('[', fp);
+        for (size_t i = 0; i < entry->alts.count; i++) {
+            const alternative_t *alt = &entry->alts.items[i];
+            fputs(i ? ",{" : "{", fp);
+            json_key(fp, "name", alt->name);
+            fputc(',', fp);
+            json_key(fp, "path", alt->path);
+            fprintf(fp, ",\"priority\":%d,", alt->priority);
+            json_key(fp, "version", alt->version);
+            fputc('}', fp);
+        }
+        fputc(']', fp);
+    }
+    fputc('}', fp);
+}
+
+static void nul_field(FILE *fp, const char *value)
+{
+    fputs(value ? value : "", fp);
+    fputc('\0', fp);
+}
+
+/*
+ * Records of NUL-terminated fields, each starting with its type:
+ *   root PATH, first and only with --root
+ *   module NAME PATH DESCRIPTION CATEGORY WATCH STATUS
+ *   link NAME LINK EXTRA TARGET RESOLVED
+ *   alternative NAME ALT-NAME PATH PRIORITY VERSION CURRENT
+ */
+static void dump_nul_entry(FILE *fp, const dump_entry_t *entry)
+{
+    const module_info_t *m = entry->module;
+
+    nul_field(fp, "module");
+    nul_field(fp, m->name);
+    nul_field(fp, m->path);
+    nul_field(fp, m->description);
+    nul_field(fp, m->category);
+    nul_field(fp, m->watch);
+    nul_field(fp, entry->has_alts ? "ok" : "failed");
+
+    for (size_t i = 0; i < entry->link_count; i++) {
+        const dump_link_t *link = &entry->links[i];
+        nul_field(fp, "link");
+        nul_field(fp, m->name);
+        nul_field(fp, link->path);
+        nul_field(fp, i ? "1" : "0");
+        nul_field(fp, link->target);
+        nul_field(fp, link->resolved);
+    }
+
+    for (size_t i = 0; i < entry->alts.count; i++) {
+        const alternative_t *alt = &entry->alts.items[i];
+        char priority[16];
+        snprintf(priority, sizeof(priority), "%d", alt->priority);
+
+        nul_field(fp, "alternative");
+        nul_field(fp, m->name);
+        nul_field(fp, alt->name);
+        nul_field(fp, alt->path);
+        nul_field(fp, priority);
+        nul_field(fp, alt->version);
+        nul_field(fp, alt == entry->current ? "1" : "0");
+    }
+}
+
+int dump_modules(module_list_t *list, int jobs, dump_format_t format, FILE *fp)
+{
+    if (!list || !fp) {
+        return -1;
+    }
+
+    uint64_t trace_start = trace_begin();
+    module_load_all_alternatives(list, jobs);
+    trace_span("load_all", trace_start, NULL, NULL);
+
+    trace_start = trace_begin();
+    const char *root = *root_dir() ? root_dir() : NULL;
+    if (format == DUMP_JSON) {
+        fputc('{', fp);
+        json_key(fp, "root", root);
+        fputs(",\"modules\":[", fp);
+    } else if (root) {
+        nul_field(fp, "root");
+        nul_field(fp, root);
+    }
+
+    /* The registry is kept sorted by name */
+    for (size_t i = 0; i < list->count; i++) {
+        dump_entry_t entry;
+        dump_entry_load(&entry, &list->modules[i]);
+        if (format == DUMP_JSON) {
+            fputs(i ? ",\n" : "\n", fp);
+            dump_json_entry(fp, &entry);
+        } else {
+            dump_nul_entry(fp, &entry);
+        }
+        dump_entry_free(&entry);
+    }
+
+    if (format == DUMP_JSON) {
+        fputs("\n]}\n", fp);
+    }
+    trace_span("output", trace_start, NULL, NULL);
+
+    return fflush(fp) == 0 && !ferror(fp) ? 0 : -1;
+}
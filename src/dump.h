@@ -0,0 +1,35 @@
+/*
+ * switch - alternatives management tool for NurOS
+ * Copyright (C) 2026 AnmiTaliDev <anmitali198@gmail.com>
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ */
+
+#ifndef SWITCH_DUMP_H
+#define SWITCH_DUMP_H
+
+#include "module.h"
+#include <stdio.h>
+
+/* Output formats of dump_modules() */
+typedef enum {
+    DUMP_JSON,
+    DUMP_NUL
+} dump_format_t;
+
+/* Parse a --format value; returns -1 if unknown */
+int dump_parse_format(const char *name, dump_format_t *format);
+
+/*
+ * Write every module's metadata, alternatives and the current target of
+ * each managed link to fp. Modules are evaluated up to jobs at a time and
+ * each at most once. Returns 0, or -1 if the output could not be written.
+ * See docs/usage.md for both formats.
+ */
+int dump_modules(module_list_t *list, int jobs, dump_format_t format, FILE *fp);
+
+#endif /* SWITCH_DUMP_H */
@@ -0,0 +1,246 @@
+/*
+ * switch - alternatives management tool for NurOS
+ * Copyright (C) 2026 AnmiTaliDev <anmitali198@gmail.com>
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+#define _DEFAULT_SOURCE
+
+#include "links.h"
+#include "pathid.h"
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+/* Parent directory shared by one or more links */
+typedef struct {
+    char *path;
+    int fd;
+} link_dir_t;
+
+/* Progress of a single link within the transaction */
+typedef struct {
+    size_t dir;             /* Index into the directory table */
+    const char *base;       /* Last path component of the link */
+    char tmp[64 + 256];     /* Temporary symlink name */
+    char *old_target;       /* Previous target, NULL if the link was absent */
+    bool created;           /* Temporary symlink exists */
+    bool renamed;           /* Temporary symlink replaced the link */
+} link_state_t;
+
+static size_t links_open_dir(link_dir_t *dirs, size_t *dir_count, const char *link,
+                             const char **base)
+{
+    const char *slash = strrchr(link, '/');
+    char *path;
+    if (!slash) {
+        path = strdup(".");
+        *base = link;
+    } else {
+        path = slash == link ? strdup("/") : strndup(link, (size_t)(slash - link));
+        *base = slash + 1;
+    }
+    if (!path) {
+        return (size_t)-1;
+    }
+
+    for (size_t i = 0; i < *dir_count; i++) {
+        if (strcmp(dirs[i].path, path) == 0) {
+            free(path);
+            return i;
+        }
+    }
+
+    int fd = path_open(path, O_RDONLY | O_DIRECTORY);
+    if (fd == -1) {
+        int saved = errno;
+        free(path);
+        errno = saved;
+        return (size_t)-1;
+    }
+
+    dirs[*dir_count] = (link_dir_t){ path, fd };
+    return (*dir_count)++;
+}
+
+/* Read the current target; *target stays NULL if nothing exists at base */
+static int links_read_old(int dirfd, const char *base, char **target)
+{
+    struct stat st;
+    *target = NULL;
+
+    if (fstatat(dirfd, base, &st, AT_SYMLINK_NOFOLLOW) != 0) {
+        return errno == ENOENT ? 0 : -1;
+    }
+    if (!S_ISLNK(st.st_mode)) {
+        errno = EEXIST;
+        return -1;
+    }
+
+    size_t size = st.st_size > 0 ? (size_t)st.st_size + 1 : 256;
+    for (;;) {
+        char *buf = malloc(size);
+        if (!buf) {
+            return -1;
+        }
+        ssize_t len = readlinkat(dirfd, base, buf, size);
+        if (len < 0) {
+            free(buf);
+            return -1;
+        }
+        if ((size_t)len < size) {
+            buf[len] = '\0';
+            *target = buf;
+            return 0;
+        }
+        free(buf);
+        size *= 2;
+    }
+}
+
+/* Create a symlink under a temporary name, replacing a stale one */
+static int links_make_tmp(int dirfd, const char *target, const char *tmp)
+{
+    if (symlinkat(target, dirfd, tmp) == 0) {
+        return 0;
+    }
+    if (errno != EEXIST || unlinkat(dirfd, tmp, 0) != 0) {
+        return -1;
+    }
+    return symlinkat(target, dirfd, tmp);
+}
+
+/* Put a switched link back to its previous state (best effort) */
+static void links_restore(int dirfd, link_state_t *state)
+{
+    if (!state->old_target) {
+        unlinkat(dirfd, state->base, 0);
+        return;
+    }
+
+    if (links_make_tmp(dirfd, state->old_target, state->tmp) == 0 &&
+        renameat(dirfd, state->tmp, dirfd, state->base) != 0) {
+        unlinkat(dirfd, state->tmp, 0);
+    }
+}
+
+int links_replace(const link_change_t *changes, size_t count, size_t *failed)
+{
+    if (count == 0) {
+        return 0;
+    }
+
+    link_dir_t *dirs = calloc(count, sizeof(link_dir_t));
+    link_state_t *states = calloc(count, sizeof(link_state_t));
+    if (!dirs || !states) {
+        free(dirs);
+        free(states);
+        *failed = 0;
+        return -1;
+    }
+
+    for (size_t j = 0; j < count; j++) {
+        states[j].dir = (size_t)-1;
+    }
+
+    size_t dir_count = 0;
+    size_t i = 0;
+    int ret = 0;
+    int saved_errno = 0;
+
+    /* Prepare: open directories, remember old targets, create temporaries */
+    for (i = 0; i < count; i++) {
+        link_state_t *state = &states[i];
+
+        state->dir = links_open_dir(dirs, &dir_count, changes[i].link, &state->base);
+        if (state->dir == (size_t)-1) {
+            goto fail;
+        }
+        if (strlen(state->base) > 255 || state->base[0] == '\0') {
+            errno = EINVAL;
+            goto fail;
+        }
+
+        int dirfd = dirs[state->dir].fd;
+        if (links_read_old(dirfd, state->base, &state->old_target) != 0) {
+            goto fail;
+        }
+
+        /* The index keeps a link named twice from sharing a temporary */
+        snprintf(state->tmp, sizeof(state->tmp), ".%s.switch-%ld-%zu",
+                 state->base, (long)getpid(), i);
+        if (!changes[i].target) {
+            continue;
+        }
+        if (links_make_tmp(dirfd, changes[i].target, state->tmp) != 0) {
+            goto fail;
+        }
+        state->created = true;
+    }
+
+    /* Commit: each rename atomically swaps one link to its new target */
+    for (i = 0; i < count; i++) {
+        link_state_t *state = &states[i];
+        int dirfd = dirs[state->dir].fd;
+
+        if (!changes[i].target) {
+            /* Removal; the temporary name is kept for links_restore() */
+            if (unlinkat(dirfd, state->base, 0) != 0 && errno != ENOENT) {
+                goto fail;
+            }
+        } else if (renameat(dirfd, state->tmp, dirfd, state->base) != 0) {
+            goto fail;
+        }
+        state->created = false;
+        state->renamed = true;
+    }
+
+    goto sync;
+
+fail:
+    saved_errno = errno;
+    *failed = i;
+    ret = -1;
+
+    for (size_t j = count; j-- > 0;) {
+        link_state_t *state = &states[j];
+        if (state->dir == (size_t)-1) {
+            continue;
+        }
+        int dirfd = dirs[state->dir].fd;
+        if (state->renamed) {
+            links_restore(dirfd, state);
+        } else if (state->created) {
+            unlinkat(dirfd, state->tmp, 0);
+        }
+    }
+
+sync:
+    /* Directory entries reach the disk once per parent directory */
+    for (size_t d = 0; d < dir_count; d++) {
+        fsync(dirs[d].fd);
+        close(dirs[d].fd);
+        free(dirs[d].path);
+    }
+    for (size_t j = 0; j < count; j++) {
+        free(states[j].old_target);
+    }
+    free(dirs);
+    free(states);
+
+    if (ret != 0) {
+        errno = saved_errno;
+    }
+    return ret;
+}
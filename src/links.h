@@ -0,0 +1,37 @@
+/*
+ * switch - alternatives management tool for NurOS
+ * Copyright (C) 2026 AnmiTaliDev <anmitali198@gmail.com>
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ */
+
+#ifndef SWITCH_LINKS_H
+#define SWITCH_LINKS_H
+
+#include <stddef.h>
+
+/* Managed symlink and the target it should point to */
+typedef struct {
+    const char *link;
+    const char *target;     /* NULL to remove the link */
+} link_change_t;
+
+/*
+ * Point every link at its target as one transaction. New symlinks are
+ * created next to the links and renamed over them, so each path always
+ * resolves to either its old or its new target. If any step fails, links
+ * already switched are restored. Each parent directory is synced once.
+ *
+ * A link without a target is removed in the same transaction, and put
+ * back if it fails. Existing paths that are not symlinks are never
+ * replaced or removed. Returns 0 on
+ * success; on failure returns -1 with errno set and *failed holding the
+ * index of the change that could not be applied.
+ */
+int links_replace(const link_change_t *changes, size_t count, size_t *failed);
+
+#endif /* SWITCH_LINKS_H */
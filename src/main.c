@@ -17,13 +17,25 @@
  * along with this program.  If not, see <https://www.gnu.org/licenses/>.
  */
 
+#define _POSIX_C_SOURCE 200809L
+#define _DEFAULT_SOURCE
+
 #include "config.h"
+#include "dump.h"
 #include "module.h"
+#include "pathid.h"
+#include "probe.h"
+#include "trace.h"
 #include "utils.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <errno.h>
 #include <getopt.h>
+#include <poll.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/wait.h>
 
 static void print_version(void)
 {
@@ -39,19 +51,38 @@ static void print_version(void)
 static void print_usage(const char *progname)
 {
     printf("Usage: %s [OPTIONS] <module> <action> [arguments...]\n", progname);
+    printf("       %s [OPTIONS] --batch [FILE]\n", progname);
     printf("\n");
     printf("Alternatives management tool for NurOS.\n");
     printf("\n");
     printf("Options:\n");
     printf("  -l, --list-modules    List all available modules\n");
+    printf("  -j, --jobs=N          Evaluate up to N modules at once (default: CPUs)\n");
+    printf("  -b, --batch           Run '<module> <action> [argument]' lines from the\n");
+    printf("                        FILE argument, or standard input if FILE is - or\n");
+    printf("                        missing\n");
     printf("  -h, --help            Show this help message\n");
     printf("  -V, --version         Show version information\n");
     printf("  --no-color            Disable colored output\n");
+    printf("  --refresh             Re-run find_alternatives, ignoring the cache\n");
+    printf("  --sort                List alternatives in ranked order once all are known\n");
+    printf("  --timeout=SECONDS     Kill and skip modules still running after SECONDS\n");
+    printf("  --trace=FILE          Write a Chrome trace of this run to FILE\n");
+    printf("  --dump                Print every module, its alternatives and links\n");
+    printf("  --format=FMT          Output of --dump: json (default) or nul\n");
+    printf("  --root=DIR            Manage the image tree at DIR; repeat to process\n");
+    printf("                        several trees concurrently\n");
+    printf("  --complete WORD...    Print completions for the last WORD (for shells)\n");
+    printf("  --probe-version[=ARG] BINARY...\n");
+    printf("                        Print the version each BINARY reports when run\n");
+    printf("                        with ARG (default %s), one per line\n",
+           PROBE_DEFAULT_FLAG);
     printf("\n");
     printf("Module actions:\n");
     printf("  list                  List available alternatives\n");
     printf("  show                  Show current alternative\n");
     printf("  set <target>          Set alternative to target\n");
+    printf("  best                  Set the highest ranked alternative\n");
     printf("  help                  Show module help\n");
     printf("\n");
     printf("Examples:\n");
@@ -59,6 +90,8 @@ static void print_usage(const char *progname)
     printf("  %s editor list          List available editors\n", progname);
     printf("  %s editor show          Show current editor\n", progname);
     printf("  %s editor set vim       Set vim as default editor\n", progname);
+    printf("  %s kernel best          Set the newest kernel\n", progname);
+    printf("  %s --batch setup.txt    Run the commands listed in setup.txt\n", progname);
     printf("\n");
     printf("Module directories:\n");
     printf("  System: %s\n", SWITCH_MODULES_DIR);
@@ -67,24 +100,564 @@ static void print_usage(const char *progname)
 
 static struct option long_options[] = {
     {"list-modules", no_argument,       NULL, 'l'},
+    {"jobs",         required_argument, NULL, 'j'},
+    {"batch",        no_argument,       NULL, 'b'},
     {"help",         no_argument,       NULL, 'h'},
     {"version",      no_argument,       NULL, 'V'},
     {"no-color",     no_argument,       NULL, 'C'},
+    {"refresh",      no_argument,       NULL, 'R'},
+    {"sort",         no_argument,       NULL, 'S'},
+    {"timeout",      required_argument, NULL, 't'},
+    {"dump",         no_argument,       NULL, 'D'},
+    {"format",       required_argument, NULL, 'F'},
+    {"trace",        required_argument, NULL, 'T'},
+    {"root",         required_argument, NULL, 'r'},
+    {"probe-version", optional_argument, NULL, 'P'},
     {NULL,           0,                 NULL, 0}
 };
 
+static int run_action(module_list_t *modules, const switch_config_t *config,
+                      const char *progname, const char *module_name,
+                      const char *action, const char *argument);
+
+/* Run one module action; returns the command's exit status */
+static int run_command(module_list_t *modules, const switch_config_t *config,
+                       const char *progname, const char *module_name,
+                       const char *action, const char *argument)
+{
+    uint64_t trace_start = trace_begin();
+    int ret = run_action(modules, config, progname, module_name, action, argument);
+    trace_span(action, trace_start, "module", module_name);
+    return ret;
+}
+
+static int run_action(module_list_t *modules, const switch_config_t *config,
+                      const char *progname, const char *module_name,
+                      const char *action, const char *argument)
+{
+    const module_info_t *module = module_lookup(modules, config, module_name);
+    if (!module) {
+        print_error("Module '%s' not found", module_name);
+        printf("\nUse '%s --list-modules' to see available modules.\n", progname);
+        return 1;
+    }
+
+    if (strcmp(action, "list") == 0) {
+        return module_action_list(module, config->sort_alternatives);
+    } else if (strcmp(action, "show") == 0) {
+        return module_action_show(module);
+    } else if (strcmp(action, "set") == 0) {
+        if (!argument) {
+            print_error("Missing argument for 'set' action");
+            printf("Usage: %s %s set <target>\n", progname, module_name);
+            return 1;
+        }
+        return module_action_set(module, argument);
+    } else if (strcmp(action, "best") == 0) {
+        return module_action_best(module);
+    } else if (strcmp(action, "help") == 0) {
+        return module_action_help(module);
+    }
+
+    print_error("Unknown action '%s'", action);
+    printf("Available actions: list, show, set, best, help\n");
+    return 1;
+}
+
+/*
+ * Run newline-separated commands from path ("-" for standard input) against
+ * a single scan. Blank lines and lines starting with '#' are skipped. The
+ * argument is the rest of the line, so targets may contain spaces.
+ */
+static int run_batch(module_list_t *modules, const switch_config_t *config,
+                     const char *progname, const char *path)
+{
+    FILE *fp = stdin;
+    if (strcmp(path, "-") != 0) {
+        fp = fopen(path, "r");
+        if (!fp) {
+            print_error("Cannot open %s: %s", path, strerror(errno));
+            return 1;
+        }
+    }
+
+    char *line = NULL;
+    size_t line_size = 0;
+    unsigned lineno = 0;
+    unsigned total = 0;
+    unsigned failed = 0;
+
+    while (getline(&line, &line_size, fp) != -1) {
+        lineno++;
+        line[strcspn(line, "\n")] = '\0';
+
+        char *saveptr = NULL;
+        char *module_name = strtok_r(line, " \t", &saveptr);
+        if (!module_name || module_name[0] == '#') {
+            continue;
+        }
+        char *action = strtok_r(NULL, " \t", &saveptr);
+        char *argument = saveptr ? saveptr + strspn(saveptr, " \t") : NULL;
+        if (argument) {
+            size_t len = strlen(argument);
+            while (len > 0 && (argument[len - 1] == ' ' || argument[len - 1] == '\t' ||
+                               argument[len - 1] == '\r')) {
+                argument[--len] = '\0';
+            }
+            if (len == 0) {
+                argument = NULL;
+            }
+        }
+        if (!action) {
+            action = "help";
+        }
+
+        total++;
+        int status = run_command(modules, config, progname, module_name, action, argument);
+        fflush(stdout);
+
+        if (status == 0) {
+            printf("%s[ok]%s %s %s%s%s\n", color_get(COLOR_GREEN), color_get(COLOR_RESET),
+                   module_name, action, argument ? " " : "", argument ? argument : "");
+        } else {
+            failed++;
+            printf("%s[failed]%s line %u: %s %s%s%s\n", color_get(COLOR_RED),
+                   color_get(COLOR_RESET), lineno, module_name, action,
+                   argument ? " " : "", argument ? argument : "");
+        }
+    }
+
+    bool read_error = ferror(fp);
+    free(line);
+    if (fp != stdin) {
+        fclose(fp);
+    }
+
+    if (read_error) {
+        print_error("Failed to read %s", path);
+        return 1;
+    }
+
+    printf("%u command%s, %u failed\n", total, total == 1 ? "" : "s", failed);
+    return failed ? 1 : 0;
+}
+
+/* Worker handling one of several --root values */
+typedef struct {
+    pid_t pid;
+    int fds[2];             /* Its stdout and stderr, -1 once at EOF */
+    FILE *streams[2];       /* What was read from each, in memory */
+    char *output[2];
+    size_t size[2];
+    uint64_t start;         /* trace_now() at fork */
+    bool running;
+    bool done;
+} root_worker_t;
+
+static void root_worker_close(root_worker_t *worker)
+{
+    for (int i = 0; i < 2; i++) {
+        if (worker->fds[i] != -1) {
+            close(worker->fds[i]);
+            worker->fds[i] = -1;
+        }
+        if (worker->streams[i]) {
+            fclose(worker->streams[i]);
+            worker->streams[i] = NULL;
+        }
+        free(worker->output[i]);
+        worker->output[i] = NULL;
+    }
+}
+
+/* Fork a worker whose stdout and stderr are pipes; 1 in the worker itself */
+static int root_worker_start(root_worker_t *worker)
+{
+    int out[2];
+    int err[2];
+    if (pipe(out) != 0) {
+        return -1;
+    }
+    if (pipe(err) != 0) {
+        close(out[0]);
+        close(out[1]);
+        return -1;
+    }
+
+    /* Nothing buffered may be written twice */
+    fflush(NULL);
+    worker->start = trace_now();
+    worker->pid = fork();
+    if (worker->pid == 0) {
+        dup2(out[1], STDOUT_FILENO);
+        dup2(err[1], STDERR_FILENO);
+    }
+    if (worker->pid <= 0) {
+        int saved = errno;
+        close(out[0]);
+        close(out[1]);
+        close(err[0]);
+        close(err[1]);
+        errno = saved;
+        return worker->pid == 0 ? 1 : -1;
+    }
+
+    close(out[1]);
+    close(err[1]);
+    worker->fds[0] = out[0];
+    worker->fds[1] = err[0];
+    for (int i = 0; i < 2; i++) {
+        worker->streams[i] = open_memstream(&worker->output[i], &worker->size[i]);
+    }
+    worker->running = true;
+    return 0;
+}
+
+static void root_worker_read(root_worker_t *worker, int stream)
+{
+    char buf[16384];
+    ssize_t n = read(worker->fds[stream], buf, sizeof(buf));
+    if (n < 0 && (errno == EINTR || errno == EAGAIN)) {
+        return;
+    }
+    if (n <= 0) {
+        close(worker->fds[stream]);
+        worker->fds[stream] = -1;
+        return;
+    }
+    if (worker->streams[stream]) {
+        fwrite(buf, 1, (size_t)n, worker->streams[stream]);
+    }
+}
+
+/* Reap a worker whose output is complete; returns its exit status */
+static int root_worker_finish(root_worker_t *worker, const char *root)
+{
+    int status;
+    while (waitpid(worker->pid, &status, 0) == -1 && errno == EINTR) {
+    }
+    for (int i = 0; i < 2; i++) {
+        if (worker->streams[i]) {
+            fclose(worker->streams[i]);
+            worker->streams[i] = NULL;
+        }
+    }
+    trace_child("root", worker->start, root, worker->pid, worker->size[0], status);
+
+    worker->running = false;
+    worker->done = true;
+    if (WIFSIGNALED(status)) {
+        print_error("%s: worker killed by signal %d", root, WTERMSIG(status));
+        return 1;
+    }
+    return WIFEXITED(status) && WEXITSTATUS(status) == 0 ? 0 : 1;
+}
+
+/*
+ * Run the command once per root, in forked workers, at most jobs at a time.
+ * Output is buffered and printed in argument order, each root's stdout
+ * under a "==> ROOT <==" header if headers is set. Returns the index of
+ * its root in a worker, which carries on with that root alone, and -1 in
+ * the parent once every worker has finished, *status being 1 if any
+ * failed.
+ */
+static int run_roots(const char **roots, int count, int jobs, bool headers, int *status)
+{
+    root_worker_t *workers = calloc((size_t)count, sizeof(root_worker_t));
+    struct pollfd *pfds = calloc((size_t)jobs * 2, sizeof(struct pollfd));
+    root_worker_t **polled = calloc((size_t)jobs * 2, sizeof(root_worker_t *));
+    *status = 0;
+    if (!workers || !pfds || !polled) {
+        print_error("Out of memory");
+        free(workers);
+        free(pfds);
+        free(polled);
+        *status = 1;
+        return -1;
+    }
+    for (int i = 0; i < count; i++) {
+        workers[i].fds[0] = workers[i].fds[1] = -1;
+    }
+
+    int next = 0;
+    int running = 0;
+    int printed = 0;
+
+    while (printed < count) {
+        while (running < jobs && next < count) {
+            root_worker_t *worker = &workers[next];
+            int started = root_worker_start(worker);
+            if (started == 1) {
+                /* Only this root's pipes stay open in the worker */
+                int index = next;
+                for (int i = 0; i < next; i++) {
+                    root_worker_close(&workers[i]);
+                }
+                free(workers);
+                free(pfds);
+                free(polled);
+                trace_detach();
+                return index;
+            }
+            if (started != 0) {
+                print_error("%s: cannot start a worker: %s", roots[next], strerror(errno));
+                worker->done = true;
+                *status = 1;
+            } else {
+                running++;
+            }
+            next++;
+        }
+
+        nfds_t nfds = 0;
+        for (int i = printed; i < next; i++) {
+            for (int k = 0; k < 2 && workers[i].running; k++) {
+                if (workers[i].fds[k] != -1) {
+                    polled[nfds] = &workers[i];
+                    pfds[nfds++] = (struct pollfd){ .fd = workers[i].fds[k], .events = POLLIN };
+                }
+            }
+        }
+
+        if (nfds > 0 && poll(pfds, nfds, -1) < 0 && errno != EINTR) {
+            print_error("poll: %s", strerror(errno));
+            break;
+        }
+        for (nfds_t i = 0; i < nfds; i++) {
+            if (pfds[i].revents) {
+                root_worker_read(polled[i], polled[i]->fds[0] == pfds[i].fd ? 0 : 1);
+            }
+        }
+
+        for (int i = printed; i < next; i++) {
+            root_worker_t *worker = &workers[i];
+            if (worker->running && worker->fds[0] == -1 && worker->fds[1] == -1) {
+                *status |= root_worker_finish(worker, roots[i]);
+                running--;
+            }
+        }
+
+        /* Each root is printed once it and every root before it are done */
+        for (; printed < next && workers[printed].done; printed++) {
+            root_worker_t *worker = &workers[printed];
+            if (headers) {
+                printf("%s==> %s <==\n", printed ? "\n" : "", roots[printed]);
+                fflush(stdout);
+            }
+            if (worker->size[1]) {
+                fwrite(worker->output[1], 1, worker->size[1], stderr);
+            }
+            if (worker->size[0]) {
+                fwrite(worker->output[0], 1, worker->size[0], stdout);
+            }
+            fflush(stdout);
+            root_worker_close(worker);
+        }
+    }
+
+    /* Only reached early on poll failure */
+    for (int i = printed; i < next; i++) {
+        if (workers[i].running) {
+            kill(workers[i].pid, SIGKILL);
+            waitpid(workers[i].pid, NULL, 0);
+        }
+        root_worker_close(&workers[i]);
+        *status = 1;
+    }
+
+    free(workers);
+    free(pfds);
+    free(polled);
+    return -1;
+}
+
+/* Module actions, in the order completion offers them */
+static const char *const action_names[] = { "list", "show", "set", "best", "help" };
+
+static void complete_candidate(const char *candidate, const char *prefix)
+{
+    if (strncmp(candidate, prefix, strlen(prefix)) == 0) {
+        printf("%s\n", candidate);
+    }
+}
+
+/* Long option matching an option word ("--jobs=2", "-j"), or NULL */
+static const struct option *complete_option(const char *word)
+{
+    for (const struct option *opt = long_options; opt->name; opt++) {
+        if (word[1] == '-') {
+            size_t len = strcspn(word + 2, "=");
+            if (strncmp(word + 2, opt->name, len) == 0 && opt->name[len] == '\0') {
+                return opt;
+            }
+        } else if (word[1] == opt->val && word[2] == '\0') {
+            return opt;
+        }
+    }
+    return NULL;
+}
+
+/*
+ * Root and environment modules are evaluated with; shared by commands and
+ * completion, which both may run module scripts and fill the caches.
+ */
+static void module_env_init(const switch_config_t *config, const char *argv0)
+{
+    /* Bash modules look for candidates under $SWITCH_ROOT */
+    set_root_dir(config->root);
+    if (config->root) {
+        setenv("SWITCH_ROOT", config->root, 1);
+    } else {
+        unsetenv("SWITCH_ROOT");
+    }
+
+    /* Modules call back into this binary through $SWITCH_BIN */
+    char *self = self_path(argv0);
+    if (self) {
+        setenv("SWITCH_BIN", self, 1);
+        free(self);
+    }
+}
+
+/*
+ * Shell completion: words are the command line after the program name,
+ * the last one being the word to complete. Candidates are printed one per
+ * line. Module names come from the scan and alternative names from
+ * module_load(), which runs no module script while its alternatives are
+ * cached; anything else is left to the shell.
+ */
+static int run_complete(switch_config_t *config, const char *argv0, char **words,
+                        int count)
+{
+    const char *current = count > 0 ? words[count - 1] : "";
+    const char *args[2] = { NULL, NULL };
+    int nargs = 0;
+
+    for (int i = 0; i < count - 1; i++) {
+        const char *word = words[i];
+        if (word[0] != '-' || word[1] == '\0') {
+            if (nargs == 2) {
+                return 0;
+            }
+            args[nargs++] = word;
+            continue;
+        }
+
+        const struct option *opt = complete_option(word);
+        if (opt && strchr("lbDPhV", opt->val)) {
+            return 0;
+        }
+        const char *value = opt ? strchr(word, '=') : NULL;
+        value = value ? value + 1 : NULL;
+        if (opt && opt->has_arg == required_argument && !value) {
+            i++;
+            if (i == count - 1) {
+                return 0;
+            }
+            value = words[i];
+        }
+
+        /* Names come from the first root, as a command would see them */
+        if (opt && opt->val == 'r' && !config->root &&
+            config_set_root(config, value) != 0) {
+            return 0;
+        }
+    }
+    module_env_init(config, argv0);
+
+    if (current[0] == '-') {
+        for (const struct option *opt = long_options; opt->name; opt++) {
+            char name[64];
+            snprintf(name, sizeof(name), "--%s", opt->name);
+            complete_candidate(name, current);
+        }
+        return 0;
+    }
+
+    module_list_t modules;
+    if (module_list_init(&modules) != 0) {
+        return 1;
+    }
+
+    if (nargs == 0) {
+        if (module_scan(&modules, config) == 0) {
+            for (size_t i = 0; i < modules.count; i++) {
+                complete_candidate(modules.modules[i].name, current);
+            }
+        }
+    } else if (nargs == 1) {
+        for (size_t i = 0; i < sizeof(action_names) / sizeof(action_names[0]); i++) {
+            complete_candidate(action_names[i], current);
+        }
+    } else if (strcmp(args[1], "set") == 0) {
+        module_info_t *module = (module_info_t *)module_lookup(&modules, config, args[0]);
+        alternative_list_t alts = {0};
+
+        module_cache_init(config);
+        module_daemon_connect(config);
+        if (module && module_load(module, &alts) == 0) {
+            for (size_t i = 0; i < alts.count; i++) {
+                complete_candidate(current[0] == '/' ? alts.items[i].path
+                                                     : alts.items[i].name, current);
+            }
+        }
+        alternative_list_free(&alts);
+        module_daemon_disconnect();
+        module_cache_finish();
+    }
+
+    module_list_free(&modules);
+    return 0;
+}
+
 int main(int argc, char *argv[])
 {
     int opt;
     bool list_modules = false;
+    bool dump = false;
+    dump_format_t dump_format = DUMP_JSON;
+    bool batch = false;
     bool no_color = false;
+    bool refresh = false;
+    bool sort = false;
+    bool probe = false;
+    const char *probe_flag = PROBE_DEFAULT_FLAG;
+    const char *trace_path = getenv("SWITCH_TRACE");
+    int jobs = 0;
+    int timeout_ms = -1;
+    const char **roots = NULL;
+    int root_count = 0;
+
+    /* Completion takes the rest of the line verbatim, options included */
+    if (argc > 1 && strcmp(argv[1], "--complete") == 0) {
+        switch_config_t config;
+        if (config_init(&config) != 0) {
+            return 1;
+        }
+        int ret = run_complete(&config, argv[0], argv + 2, argc - 2);
+        config_free(&config);
+        return ret;
+    }
 
     /* Parse command line options */
-    while ((opt = getopt_long(argc, argv, "lhV", long_options, NULL)) != -1) {
+    while ((opt = getopt_long(argc, argv, "lj:bhV", long_options, NULL)) != -1) {
         switch (opt) {
         case 'l':
             list_modules = true;
             break;
+        case 'j': {
+            char *end;
+            long value = strtol(optarg, &end, 10);
+            if (*optarg == '\0' || *end != '\0' || value < 1 || value > 1024) {
+                fprintf(stderr, "%s: invalid job count '%s'\n", argv[0], optarg);
+                return 1;
+            }
+            jobs = (int)value;
+            break;
+        }
+        case 'b':
+            batch = true;
+            break;
         case 'h':
             print_usage(argv[0]);
             return 0;
@@ -94,12 +667,61 @@ int main(int argc, char *argv[])
         case 'C':
             no_color = true;
             break;
+        case 'R':
+            refresh = true;
+            break;
+        case 'S':
+            sort = true;
+            break;
+        case 'D':
+            dump = true;
+            break;
+        case 'F':
+            if (dump_parse_format(optarg, &dump_format) != 0) {
+                fprintf(stderr, "%s: unknown format '%s'\n", argv[0], optarg);
+                return 1;
+            }
+            break;
+        case 't':
+            if (config_parse_timeout(optarg, &timeout_ms) != 0) {
+                fprintf(stderr, "%s: invalid timeout '%s'\n", argv[0], optarg);
+                return 1;
+            }
+            break;
+        case 'T':
+            trace_path = optarg;
+            break;
+        case 'r': {
+            const char **grown = realloc(roots, (size_t)(root_count + 1) * sizeof(*roots));
+            if (!grown) {
+                fprintf(stderr, "%s: out of memory\n", argv[0]);
+                free(roots);
+                return 1;
+            }
+            roots = grown;
+            roots[root_count++] = optarg;
+            break;
+        }
+        case 'P':
+            probe = true;
+            if (optarg) {
+                probe_flag = optarg;
+            }
+            break;
         default:
             fprintf(stderr, "Try '%s --help' for more information.\n", argv[0]);
             return 1;
         }
     }
 
+    /* Tracing starts before any work so that every phase is covered */
+    if (trace_path && *trace_path && trace_open(trace_path) != 0) {
+        print_warning("Cannot write trace to %s", trace_path);
+    }
+    /* Module children, such as "$SWITCH_BIN" --probe-version, must not reopen it */
+    unsetenv("SWITCH_TRACE");
+    uint64_t trace_start = trace_begin();
+
     /* Initialize color support */
     color_init();
     if (no_color) {
@@ -112,28 +734,113 @@ int main(int argc, char *argv[])
         print_error("Failed to initialize configuration");
         return 1;
     }
+    if (jobs > 0) {
+        config.jobs = jobs;
+    }
+    if (timeout_ms >= 0) {
+        config.timeout_ms = timeout_ms;
+    }
+    config.refresh = refresh;
+    config.sort_alternatives = sort;
+
+    /* --probe-version needs no modules */
+    if (probe) {
+        trace_span("config", trace_start, NULL, NULL);
+        int ret = probe_versions(&config, probe_flag, argv + optind,
+                                 (size_t)(argc - optind));
+        config_free(&config);
+        free(roots);
+        trace_close();
+        return ret == 0 ? 0 : 1;
+    }
 
     /* Initialize module list */
     module_list_t modules;
     if (module_list_init(&modules) != 0) {
         print_error("Failed to initialize module list");
+        free(roots);
         config_free(&config);
+        trace_close();
         return 1;
     }
 
-    /* Scan for modules */
-    if (module_scan(&modules, &config) != 0) {
-        print_error("Failed to scan modules");
-        module_list_free(&modules);
-        config_free(&config);
-        return 1;
+    int ret = 0;
+
+    /* Several roots are processed alike by one worker each */
+    const char *root = root_count > 0 ? roots[0] : NULL;
+    if (root_count > 1) {
+        if (batch && (optind >= argc || strcmp(argv[optind], "-") == 0)) {
+            print_error("--batch cannot read standard input for several roots");
+            free(roots);
+            ret = 1;
+            goto cleanup;
+        }
+
+        int pool = config.jobs < root_count ? config.jobs : root_count;
+        int status;
+        int index = run_roots(roots, root_count, pool, !dump, &status);
+        if (index < 0) {
+            free(roots);
+            ret = status;
+            goto cleanup;
+        }
+
+        /* The workers share the CPUs */
+        root = roots[index];
+        config.jobs = config.jobs / pool > 0 ? config.jobs / pool : 1;
     }
 
-    int ret = 0;
+    int rooted = root ? config_set_root(&config, root) : 0;
+    free(roots);
+    if (rooted != 0) {
+        ret = 1;
+        goto cleanup;
+    }
+
+    module_env_init(&config, argv[0]);
+
+    trace_span("config", trace_start, NULL, NULL);
+
+    /* Only listing and dumping need every module; actions look theirs up by name */
+    if (list_modules || dump) {
+        trace_start = trace_begin();
+        int scanned = module_scan(&modules, &config);
+        trace_span("scan", trace_start, NULL, NULL);
+        if (scanned != 0) {
+            print_error("Failed to scan modules");
+            ret = 1;
+            goto cleanup;
+        }
+    }
+
+    trace_start = trace_begin();
+    if (module_cache_init(&config) != 0) {
+        print_warning("Metadata cache unavailable");
+    }
+    module_daemon_connect(&config);
+    trace_span("cache_init", trace_start, NULL, NULL);
 
     /* Handle --list-modules */
     if (list_modules) {
-        module_print_list(&modules);
+        trace_start = trace_begin();
+        module_print_list(&modules, config.jobs);
+        trace_span("list_modules", trace_start, NULL, NULL);
+        goto cleanup;
+    }
+
+    /* Handle --dump */
+    if (dump) {
+        ret = dump_modules(&modules, config.jobs, dump_format, stdout);
+        if (ret != 0) {
+            print_error("Failed to write the dump");
+            ret = 1;
+        }
+        goto cleanup;
+    }
+
+    /* Handle --batch */
+    if (batch) {
+        ret = run_batch(&modules, &config, argv[0], optind < argc ? argv[optind] : "-");
         goto cleanup;
     }
 
@@ -146,39 +853,19 @@ int main(int argc, char *argv[])
 
     const char *module_name = argv[optind];
     const char *action = (optind + 1 < argc) ? argv[optind + 1] : "help";
-
-    /* Find module */
-    const module_info_t *module = module_find(&modules, module_name);
-    if (!module) {
-        print_error("Module '%s' not found", module_name);
-        printf("\nUse '%s --list-modules' to see available modules.\n", argv[0]);
-        ret = 1;
-        goto cleanup;
-    }
+    const char *argument = (optind + 2 < argc) ? argv[optind + 2] : NULL;
 
     /* Execute module action */
-    if (strcmp(action, "list") == 0) {
-        ret = module_action_list(module);
-    } else if (strcmp(action, "show") == 0) {
-        ret = module_action_show(module);
-    } else if (strcmp(action, "set") == 0) {
-        if (optind + 2 >= argc) {
-            print_error("Missing argument for 'set' action");
-            printf("Usage: %s %s set <target>\n", argv[0], module_name);
-            ret = 1;
-        } else {
-            ret = module_action_set(module, argv[optind + 2]);
-        }
-    } else if (strcmp(action, "help") == 0) {
-        ret = module_action_help(module);
-    } else {
-        print_error("Unknown action '%s'", action);
-        printf("Available actions: list, show, set, help\n");
-        ret = 1;
-    }
+    ret = run_command(&modules, &config, argv[0], module_name, action, argument);
 
 cleanup:
+    trace_start = trace_begin();
+    module_daemon_disconnect();
+    module_cache_finish();
+    trace_span("cache_finish", trace_start, NULL, NULL);
     module_list_free(&modules);
     config_free(&config);
+    path_memo_clear();
+    trace_close();
     return ret;
 }
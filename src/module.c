@@ -9,73 +9,128 @@
  * (at your option) any later version.
  */
 
-#define _POSIX_C_SOURCE 200809L
-#define _DEFAULT_SOURCE
+/* SO_PEERCRED to check who runs switchd */
+#define _GNU_SOURCE
 
 #include "module.h"
+#include "arena.h"
+#include "cache.h"
+#include "links.h"
+#include "pathid.h"
+#include "process.h"
+#include "scan.h"
+#include "script.h"
+#include "spec.h"
+#include "trace.h"
 #include "utils.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <dirent.h>
 #include <unistd.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
 #include <sys/wait.h>
 #include <errno.h>
 
 #define INITIAL_CAPACITY 32
+#define INITIAL_INDEX_CAPACITY 64
 
-int module_list_init(module_list_t *list)
+static bool has_suffix(const char *s, const char *suffix)
 {
-    if (!list) {
-        return -1;
+    size_t len = strlen(s);
+    size_t suffix_len = strlen(suffix);
+    return len >= suffix_len && strcmp(s + len - suffix_len, suffix) == 0;
+}
+
+/* FNV-1a hash of a module name */
+static uint64_t hash_name(const char *name)
+{
+    uint64_t hash = 14695981039346656037u;
+    for (const unsigned char *p = (const unsigned char *)name; *p; p++) {
+        hash ^= *p;
+        hash *= 1099511628211u;
     }
+    return hash;
+}
 
-    list->modules = malloc(INITIAL_CAPACITY * sizeof(module_info_t));
-    if (!list->modules) {
+/* Slot of name in the index: its own slot if present, else the empty one */
+static size_t module_index_slot(const module_list_t *list, const char *name)
+{
+    size_t mask = list->index_capacity - 1;
+    size_t slot = (size_t)hash_name(name) & mask;
+
+    while (list->index[slot] != 0 &&
+           strcmp(list->modules[list->index[slot] - 1].name, name) != 0) {
+        slot = (slot + 1) & mask;
+    }
+    return slot;
+}
+
+/* Rebuild the open-addressing index (slots hold module index + 1) */
+static int module_index_rebuild(module_list_t *list, size_t capacity)
+{
+    uint32_t *index = calloc(capacity, sizeof(uint32_t));
+    if (!index) {
         return -1;
     }
 
-    list->count = 0;
-    list->capacity = INITIAL_CAPACITY;
+    free(list->index);
+    list->index = index;
+    list->index_capacity = capacity;
+
+    for (size_t i = 0; i < list->count; i++) {
+        list->index[module_index_slot(list, list->modules[i].name)] = (uint32_t)(i + 1);
+    }
     return 0;
 }
 
-void module_list_free(module_list_t *list)
+int module_list_init(module_list_t *list)
 {
     if (!list) {
-        return;
+        return -1;
     }
 
-    for (size_t i = 0; i < list->count; i++) {
-        free(list->modules[i].name);
-        free(list->modules[i].path);
-        free(list->modules[i].description);
-        free(list->modules[i].category);
-        free(list->modules[i].link_path);
-        free(list->modules[i].extra_links);
+    memset(list, 0, sizeof(*list));
+    list->modules = malloc(INITIAL_CAPACITY * sizeof(module_info_t));
+    list->arena = calloc(1, sizeof(arena_t));
+    list->index = calloc(INITIAL_INDEX_CAPACITY, sizeof(uint32_t));
+    if (!list->modules || !list->arena || !list->index) {
+        free(list->modules);
+        free(list->arena);
+        free(list->index);
+        return -1;
     }
 
-    free(list->modules);
-    list->modules = NULL;
-    list->count = 0;
-    list->capacity = 0;
+    list->capacity = INITIAL_CAPACITY;
+    list->index_capacity = INITIAL_INDEX_CAPACITY;
+    return 0;
 }
 
-void alternative_list_free(alternative_list_t *list)
+void module_list_free(module_list_t *list)
 {
     if (!list) {
         return;
     }
 
-    for (size_t i = 0; i < list->count; i++) {
-        free(list->items[i].path);
-        free(list->items[i].name);
+    /* Every string of every module lives in the arena */
+    if (list->arena) {
+        arena_free(list->arena);
+        free(list->arena);
     }
 
-    free(list->items);
-    list->items = NULL;
+    free(list->modules);
+    free(list->index);
+    list->modules = NULL;
+    list->arena = NULL;
+    list->index = NULL;
     list->count = 0;
     list->capacity = 0;
+    list->index_capacity = 0;
 }
 
 static int module_list_add(module_list_t *list, const char *name,
@@ -92,293 +147,1708 @@ static int module_list_add(module_list_t *list, const char *name,
         list->capacity = new_capacity;
     }
 
+    /* Keep the index at most half full */
+    if ((list->count + 1) * 2 > list->index_capacity &&
+        module_index_rebuild(list, list->index_capacity * 2) != 0) {
+        return -1;
+    }
+
     module_info_t *module = &list->modules[list->count];
     memset(module, 0, sizeof(*module));
 
-    module->name = strdup(name);
-    module->path = strdup(path);
+    module->name = arena_strdup(list->arena, name);
+    module->path = arena_strdup(list->arena, path);
     module->is_user = is_user;
+    module->declarative = has_suffix(path, ".switch");
+    module->arena = list->arena;
 
     if (!module->name || !module->path) {
-        free(module->name);
-        free(module->path);
         return -1;
     }
 
+    list->index[module_index_slot(list, module->name)] = (uint32_t)(list->count + 1);
     list->count++;
     return 0;
 }
 
+static int module_compare_name(const void *a, const void *b)
+{
+    const module_info_t *ma = a;
+    const module_info_t *mb = b;
+    return strcmp(ma->name, mb->name);
+}
+
+/* Registers each script found by scan_scripts() */
+typedef struct {
+    module_list_t *list;
+    const char *dir_path;
+    bool is_user;
+} scan_target_t;
+
+static void scan_add(const char *file_name, size_t len, void *data)
+{
+    scan_target_t *target = data;
+    bool declarative = has_suffix(file_name, ".switch");
+
+    char name[256];
+    size_t name_len = len - (declarative ? strlen(".switch") : strlen(".sh"));
+    if (name_len >= sizeof(name)) {
+        return;
+    }
+    memcpy(name, file_name, name_len);
+    name[name_len] = '\0';
+
+    char path[4096];
+    snprintf(path, sizeof(path), "%s/%s", target->dir_path, file_name);
+
+    /*
+     * User modules are scanned first and shadow system ones. Within one
+     * directory a .switch file wins over a script of the same name.
+     */
+    module_list_t *list = target->list;
+    uint32_t entry = list->index[module_index_slot(list, name)];
+    if (entry == 0) {
+        module_list_add(list, name, path, target->is_user);
+    } else if (declarative) {
+        module_info_t *module = &list->modules[entry - 1];
+        if (module->is_user == target->is_user && !module->declarative) {
+            module->path = arena_strdup(list->arena, path);
+            module->declarative = module->path != NULL;
+        }
+    }
+}
+
 static int scan_directory(module_list_t *list, const char *dir_path, bool is_user)
 {
-    if (!dir_exists(dir_path)) {
+    uint64_t trace_start = trace_begin();
+    scan_target_t target = { list, dir_path, is_user };
+    int ret = scan_scripts(dir_path, scan_add, &target);
+    trace_span("scan_directory", trace_start, "dir", dir_path);
+    return ret;
+}
+
+int module_scan(module_list_t *list, const switch_config_t *config)
+{
+    if (!list || !config) {
+        return -1;
+    }
+
+    if (config->user_modules_dir) {
+        scan_directory(list, config->user_modules_dir, true);
+    }
+
+    if (config->system_modules_dir) {
+        scan_directory(list, config->system_modules_dir, false);
+    }
+
+    /* Iteration order is by name, whatever order readdir() used */
+    qsort(list->modules, list->count, sizeof(module_info_t), module_compare_name);
+    return module_index_rebuild(list, list->index_capacity);
+}
+
+const module_info_t *module_find(const module_list_t *list, const char *name)
+{
+    if (!list || !name) {
+        return NULL;
+    }
+
+    uint32_t entry = list->index[module_index_slot(list, name)];
+    return entry ? &list->modules[entry - 1] : NULL;
+}
+
+/* Path of module name in dir: a readable .switch file or an executable script */
+static bool module_probe(const char *dir, const char *name, char *path, size_t size)
+{
+    int len = snprintf(path, size, "%s/%s.switch", dir, name);
+    if (len > 0 && (size_t)len < size && faccessat(AT_FDCWD, path, R_OK, 0) == 0) {
+        return true;
+    }
+
+    len = snprintf(path, size, "%s/%s.sh", dir, name);
+    if (len < 0 || (size_t)len >= size) {
+        return false;
+    }
+    return faccessat(AT_FDCWD, path, X_OK, 0) == 0;
+}
+
+const module_info_t *module_lookup(module_list_t *list, const switch_config_t *config,
+                                   const char *name)
+{
+    if (!list || !config || !name) {
+        return NULL;
+    }
+
+    const module_info_t *module = module_find(list, name);
+    if (module) {
+        return module;
+    }
+
+    /* Only names a scan could have produced */
+    size_t len = strlen(name);
+    if (len == 0 || len >= 256 || name[0] == '.' || strchr(name, '/')) {
+        return NULL;
+    }
+
+    uint64_t trace_start = trace_begin();
+    char path[4096];
+    bool is_user = config->user_modules_dir &&
+                   module_probe(config->user_modules_dir, name, path, sizeof(path));
+    bool found = is_user || (config->system_modules_dir &&
+                             module_probe(config->system_modules_dir, name,
+                                          path, sizeof(path)));
+    trace_span("lookup", trace_start, "module", name);
+
+    if (!found || module_list_add(list, name, path, is_user) != 0) {
+        return NULL;
+    }
+    return &list->modules[list->count - 1];
+}
+
+/* Metadata variables returned by a module evaluation, in record order */
+enum {
+    FIELD_DESCRIPTION,
+    FIELD_CATEGORY,
+    FIELD_LINK,
+    FIELD_EXTRA_LINKS,
+    FIELD_WATCH,
+    FIELD_COUNT
+};
+
+static const char *const field_vars[FIELD_COUNT] = {
+    [FIELD_DESCRIPTION] = "MODULE_DESCRIPTION",
+    [FIELD_CATEGORY]    = "MODULE_CATEGORY",
+    [FIELD_LINK]        = "MODULE_LINK",
+    [FIELD_EXTRA_LINKS] = "MODULE_EXTRA_LINKS",
+    [FIELD_WATCH]       = "MODULE_WATCH",
+};
+
+/* The same fields as keys of a declarative module's [module] section */
+static const char *const field_keys[FIELD_COUNT] = {
+    [FIELD_DESCRIPTION] = "description",
+    [FIELD_CATEGORY]    = "category",
+    [FIELD_LINK]        = "link",
+    [FIELD_EXTRA_LINKS] = "extra_links",
+    [FIELD_WATCH]       = "watch",
+};
+
+/* Persistent metadata cache, enabled by module_cache_init() */
+static metadata_cache_t g_cache;
+static bool g_cache_enabled = false;
+
+/* Ignore cached alternatives (they are still rewritten) */
+static bool g_refresh = false;
+
+/* Limit for one module evaluation in ms, 0 for none */
+static int g_timeout_ms = 0;
+
+#define ALTERNATIVES_CACHE_SUBDIR "alternatives"
+
+/* Connection to switchd, see module_daemon_connect() */
+static int g_daemon_fd = -1;
+
+/* How long to wait for a switchd reply before evaluating locally */
+#define DAEMON_TIMEOUT_MS 30000
+
+int module_cache_init(const switch_config_t *config)
+{
+    if (!config) {
         return 0;
     }
 
-    DIR *dir = opendir(dir_path);
-    if (!dir) {
+    g_refresh = config->refresh;
+    g_timeout_ms = config->timeout_ms;
+
+    /* A hung module is killed together with everything it started */
+    spawn_set_process_groups(g_timeout_ms > 0);
+
+    if (!config->cache_dir || getenv("SWITCH_NO_CACHE")) {
+        return 0;
+    }
+
+    if (metadata_cache_open(&g_cache, config->cache_dir, FIELD_COUNT) != 0) {
+        return -1;
+    }
+
+    g_cache_enabled = true;
+    return 0;
+}
+
+void module_cache_finish(void)
+{
+    if (!g_cache_enabled) {
+        return;
+    }
+
+    if (metadata_cache_flush(&g_cache) != 0) {
+        print_warning("Failed to update metadata cache in %s", g_cache.dir);
+    }
+
+    if (getenv("SWITCH_CACHE_STATS")) {
+        fprintf(stderr, "switch: metadata cache: %u hits, %u misses\n",
+                g_cache.hits, g_cache.misses);
+    }
+
+    metadata_cache_close(&g_cache);
+    g_cache_enabled = false;
+}
+
+/*
+ * Build the shell program for module evaluations. __switch_eval sources a
+ * script ($1) once, writes every metadata variable as a netstring
+ * ("<len>:<bytes>,") and, when $2 is non-empty, appends the raw
+ * find_alternatives output after the last record.
+ *
+ * A one-shot program evaluates its own arguments. A module host instead
+ * reads requests ("<script>\n<flag>\n") from stdin and answers each with
+ * the record above wrapped in one more netstring. Every script is sourced
+ * in a subshell, so modules cannot see each other's state.
+ */
+static char *build_eval_program(bool host)
+{
+    static const char prologue[] =
+        /* Helper for modules: print one alternative with '|', '\\' and newlines escaped */
+        "switch_alternative() {\n"
+        "    local __switch_field __switch_out=\n"
+        "    for __switch_field in \"$1\" \"$2\" \"${3:-10}\" \"${@:4:1}\"; do\n"
+        "        __switch_field=${__switch_field//'\\'/'\\\\'}\n"
+        "        __switch_field=${__switch_field//|/'\\|'}\n"
+        "        __switch_field=${__switch_field//$'\\n'/'\\n'}\n"
+        "        __switch_out+=\"$__switch_field|\"\n"
+        "    done\n"
+        "    printf '%s\\n' \"${__switch_out%|}\"\n"
+        "}\n"
+        "__switch_emit() { local LC_ALL=C; printf '%d:%s,' \"${#1}\" \"$1\"; }\n"
+        "__switch_eval() {\n"
+        "    source \"$1\" >/dev/null </dev/null || return 1\n"
+        "    local __switch_var\n"
+        "    for __switch_var in";
+    static const char epilogue[] =
+        "; do __switch_emit \"${!__switch_var-}\"; done\n"
+        "    [[ -n $2 ]] && find_alternatives </dev/null\n"
+        "    return 0\n"
+        "}\n";
+    static const char oneshot[] =
+        "__switch_eval \"$1\" \"$2\"\n"
+        "exit 0\n";
+    static const char host_loop[] =
+        "while IFS= read -r __switch_path && IFS= read -r __switch_alts; do\n"
+        "    __switch_out=$(__switch_eval \"$__switch_path\" \"$__switch_alts\"; printf .)\n"
+        "    __switch_emit \"${__switch_out%.}\"\n"
+        "done\n";
+
+    size_t len = sizeof(prologue) + sizeof(epilogue) + sizeof(host_loop);
+    for (size_t i = 0; i < FIELD_COUNT; i++) {
+        len += strlen(field_vars[i]) + 1;
+    }
+
+    char *program = malloc(len);
+    if (!program) {
+        return NULL;
+    }
+
+    char *p = stpcpy(program, prologue);
+    for (size_t i = 0; i < FIELD_COUNT; i++) {
+        *p++ = ' ';
+        p = stpcpy(p, field_vars[i]);
+    }
+    p = stpcpy(p, epilogue);
+    stpcpy(p, host ? host_loop : oneshot);
+
+    return program;
+}
+
+/* Parse one netstring; empty values are returned as NULL */
+static int parse_netstring(const char **pos, const char *end, char **value)
+{
+    const char *p = *pos;
+    size_t len = 0;
+
+    if (p >= end || *p < '0' || *p > '9') {
+        return -1;
+    }
+    while (p < end && *p >= '0' && *p <= '9') {
+        len = len * 10 + (size_t)(*p++ - '0');
+        /* Longer than what is left; also keeps len from wrapping */
+        if (len > (size_t)(end - p)) {
+            return -1;
+        }
+    }
+    if (p >= end || *p++ != ':' || (size_t)(end - p) < len + 1 || p[len] != ',') {
+        return -1;
+    }
+
+    *value = len ? strndup(p, len) : NULL;
+    if (len && !*value) {
+        return -1;
+    }
+
+    *pos = p + len + 1;
+    return 0;
+}
+
+/*
+ * Size of the complete netstring at p, 0 if more bytes are needed, or -1
+ * if p does not start a netstring.
+ */
+static ssize_t netstring_span(const char *p, size_t avail)
+{
+    size_t i = 0;
+    size_t len = 0;
+
+    while (i < avail && p[i] >= '0' && p[i] <= '9') {
+        /* No reply is that large; also keeps len from wrapping */
+        if (len > SSIZE_MAX / 20) {
+            return -1;
+        }
+        len = len * 10 + (size_t)(p[i++] - '0');
+    }
+    if (i == avail) {
+        return 0;
+    }
+    if (i == 0 || p[i++] != ':') {
+        return -1;
+    }
+    if (avail - i < len + 1) {
+        return 0;
+    }
+    return p[i + len] == ',' ? (ssize_t)(i + len + 1) : -1;
+}
+
+/* Module evaluation running in a bash child, or a module host */
+typedef struct {
+    pid_t pid;
+    int fd;             /* Read end of the child's stdout */
+    int in_fd;          /* Request pipe of a module host, -1 otherwise */
+    char *output;
+    size_t size;
+    size_t capacity;
+    size_t request;     /* Caller-defined index */
+    bool busy;          /* Module host is answering a request */
+    bool timed_out;     /* Killed at its deadline; output is discarded */
+    uint64_t deadline;  /* trace_now() limit of the evaluation, 0 for none */
+    const char *module; /* Module being evaluated, for tracing */
+    uint64_t trace_start;   /* Child start, for tracing */
+    uint64_t request_start; /* Start of the pending host request */
+} eval_job_t;
+
+#define EVAL_READ_CHUNK ALTERNATIVES_READ_CHUNK
+
+/* Deadline for an evaluation starting now */
+static uint64_t eval_deadline(void)
+{
+    return g_timeout_ms > 0 ? trace_now() + (uint64_t)g_timeout_ms * 1000000u : 0;
+}
+
+/* poll() timeout in ms until deadline (-1 without one), rounded up */
+static int deadline_timeout(uint64_t deadline)
+{
+    if (!deadline) {
+        return -1;
+    }
+    uint64_t now = trace_now();
+    return now < deadline ? (int)((deadline - now + 999999u) / 1000000u) : 0;
+}
+
+/* Wait for the job's output: 1 once readable, 0 when the deadline passed */
+static int eval_wait(eval_job_t *job)
+{
+    struct pollfd pfd = { .fd = job->fd, .events = POLLIN };
+    for (;;) {
+        int timeout = deadline_timeout(job->deadline);
+        if (timeout == 0) {
+            return 0;
+        }
+        int ready = poll(&pfd, 1, timeout);
+        if (ready != 0 && !(ready < 0 && errno == EINTR)) {
+            return 1;
+        }
+    }
+}
+
+/* Kill a job that missed its deadline; its module is reported and skipped */
+static void eval_expire(eval_job_t *job)
+{
+    print_warning("Module '%s' did not finish within %.1f s; skipped",
+                  job->module ? job->module : "?", g_timeout_ms / 1000.0);
+    spawn_kill(job->pid);
+    job->timed_out = true;
+}
+
+static int eval_start(eval_job_t *job, const module_info_t *module, bool with_alts)
+{
+    memset(job, 0, sizeof(*job));
+    job->fd = -1;
+    job->in_fd = -1;
+    job->pid = -1;
+
+    job->module = module->name;
+    job->trace_start = trace_begin();
+
+    char *program = build_eval_program(false);
+    if (!program) {
         return -1;
     }
 
-    struct dirent *entry;
-    while ((entry = readdir(dir)) != NULL) {
-        if (entry->d_name[0] == '.') {
+    char *argv[] = {
+        "bash", "-c", program, "bash",
+        module->path, with_alts ? "1" : "", NULL
+    };
+
+    spawn_child_t child;
+    int ret = spawn_with_pipe(&child, "/bin/bash", argv);
+    free(program);
+
+    if (ret != 0) {
+        print_error("Failed to start bash for module '%s': %s (spawn: %.2f ms)",
+                    module->name, strerror(child.error), child.spawn_ms);
+        return -1;
+    }
+
+    job->pid = child.pid;
+    job->fd = child.out_fd;
+    job->deadline = eval_deadline();
+    fcntl(job->fd, F_SETFL, fcntl(job->fd, F_GETFL) | O_NONBLOCK);
+    return 0;
+}
+
+/* Make room for one read (plus a terminating NUL) in the job's output */
+static int eval_reserve(eval_job_t *job)
+{
+    if (job->capacity - job->size < EVAL_READ_CHUNK + 1) {
+        size_t new_capacity = job->capacity ? job->capacity * 2 : EVAL_READ_CHUNK * 2;
+        char *new_output = realloc(job->output, new_capacity);
+        if (!new_output) {
+            return -1;
+        }
+        job->output = new_output;
+        job->capacity = new_capacity;
+    }
+    return 0;
+}
+
+/* Read available output: 1 at end of output, 0 if more may follow, -1 on error */
+static int eval_read(eval_job_t *job)
+{
+    for (;;) {
+        if (eval_reserve(job) != 0) {
+            return -1;
+        }
+
+        ssize_t n = read(job->fd, job->output + job->size,
+                         job->capacity - job->size - 1);
+        if (n > 0) {
+            job->size += (size_t)n;
+        } else if (n == 0) {
+            return 1;
+        } else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+            return 0;
+        } else if (errno != EINTR) {
+            return -1;
+        }
+    }
+}
+
+/* Read until end of output: 1 at the end, -1 on error or timeout */
+static int eval_drain(eval_job_t *job)
+{
+    int ret;
+    while ((ret = eval_read(job)) == 0) {
+        if (!eval_wait(job)) {
+            eval_expire(job);
+            return -1;
+        }
+    }
+    return ret;
+}
+
+/*
+ * Parse an evaluation record (NUL-terminated at size) into fields and, if
+ * non-NULL, alts. When raw is non-NULL the unparsed find_alternatives
+ * output is returned there (caller frees).
+ */
+static void parse_record(char *record, size_t size, char *fields[FIELD_COUNT],
+                         alternative_list_t *alts, char **raw)
+{
+    const char *pos = record;
+    const char *end = record + size;
+    for (size_t i = 0; i < FIELD_COUNT; i++) {
+        if (parse_netstring(&pos, end, &fields[i]) != 0) {
+            break;
+        }
+    }
+
+    /* Alternatives follow the metadata records */
+    char *rest = record + (pos - record);
+    if (raw) {
+        *raw = strdup(rest);
+    }
+    if (alts) {
+        alternatives_feed(alts, rest, size - (size_t)(pos - record));
+        alternatives_finish(alts);
+    }
+}
+
+/* Reap the child and parse its output; see parse_record() */
+static void eval_finish(eval_job_t *job, char *fields[FIELD_COUNT],
+                        alternative_list_t *alts, char **raw)
+{
+    for (size_t i = 0; i < FIELD_COUNT; i++) {
+        fields[i] = NULL;
+    }
+    if (raw) {
+        *raw = NULL;
+    }
+
+    close(job->fd);
+    job->fd = -1;
+
+    int status;
+    while (waitpid(job->pid, &status, 0) == -1 && errno == EINTR) {
+    }
+    trace_child("bash", job->trace_start, job->module, job->pid, job->size, status);
+
+    if (job->output && !job->timed_out) {
+        job->output[job->size] = '\0';
+        parse_record(job->output, job->size, fields, alts, raw);
+    }
+
+    free(job->output);
+    job->output = NULL;
+}
+
+static int host_start(eval_job_t *job)
+{
+    memset(job, 0, sizeof(*job));
+    job->fd = -1;
+    job->in_fd = -1;
+    job->pid = -1;
+
+    job->trace_start = trace_begin();
+
+    char *program = build_eval_program(true);
+    if (!program) {
+        return -1;
+    }
+
+    char *argv[] = { "bash", "-c", program, "bash", NULL };
+    spawn_child_t child;
+    int ret = spawn_coprocess(&child, "/bin/bash", argv);
+    free(program);
+
+    if (ret != 0) {
+        print_error("Failed to start module host: %s (spawn: %.2f ms)",
+                    strerror(child.error), child.spawn_ms);
+        return -1;
+    }
+
+    job->pid = child.pid;
+    job->fd = child.out_fd;
+    job->in_fd = child.in_fd;
+    fcntl(job->fd, F_SETFL, fcntl(job->fd, F_GETFL) | O_NONBLOCK);
+    return 0;
+}
+
+/* Ask a module host to evaluate a module's metadata and maybe its alternatives */
+static int host_send(eval_job_t *job, const module_info_t *module, size_t request,
+                     bool with_alts)
+{
+    /* Requests are line based */
+    if (strchr(module->path, '\n')) {
+        return -1;
+    }
+
+    size_t len = strlen(module->path) + 3;
+    char *line = malloc(len + 1);
+    if (!line) {
+        return -1;
+    }
+    snprintf(line, len + 1, "%s\n%s\n", module->path, with_alts ? "1" : "");
+    len = strlen(line);
+
+    size_t off = 0;
+    while (off < len) {
+        ssize_t n = write(job->in_fd, line + off, len - off);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            free(line);
+            return -1;
+        }
+        off += (size_t)n;
+    }
+
+    free(line);
+    job->request = request;
+    job->busy = true;
+    job->module = module->name;
+    job->request_start = trace_begin();
+    job->deadline = eval_deadline();
+    return 0;
+}
+
+/*
+ * Take a complete reply from the host's buffer. Returns 1 and fills fields
+ * (and raw, see parse_record()) when a reply was consumed, 2 if the reply
+ * was empty, 0 if more data is needed, -1 if the stream is malformed.
+ */
+static int host_take_reply(eval_job_t *job, char *fields[FIELD_COUNT], char **raw)
+{
+    size_t len = 0;
+    size_t i = 0;
+
+    while (i < job->size && job->output[i] >= '0' && job->output[i] <= '9') {
+        len = len * 10 + (size_t)(job->output[i++] - '0');
+    }
+    if (i == job->size) {
+        return 0;
+    }
+    if (i == 0 || job->output[i] != ':') {
+        return -1;
+    }
+
+    size_t start = i + 1;
+    if (job->size - start < len + 1) {
+        return 0;
+    }
+    if (job->output[start + len] != ',') {
+        return -1;
+    }
+
+    for (size_t f = 0; f < FIELD_COUNT; f++) {
+        fields[f] = NULL;
+    }
+    if (raw) {
+        *raw = NULL;
+    }
+    job->output[start + len] = '\0';
+    if (len) {
+        parse_record(job->output + start, len, fields, NULL, raw);
+    }
+
+    size_t consumed = start + len + 1;
+    if (job->pid != -1) {
+        trace_child("host_request", job->request_start, job->module, job->pid, consumed, -1);
+    }
+    memmove(job->output, job->output + consumed, job->size - consumed);
+    job->size -= consumed;
+    job->busy = false;
+    return len ? 1 : 2;
+}
+
+/* Close the request pipe and reap the host */
+static void host_stop(eval_job_t *job)
+{
+    if (job->pid == -1) {
+        return;
+    }
+
+    close(job->in_fd);
+    close(job->fd);
+
+    int status;
+    while (waitpid(job->pid, &status, 0) == -1 && errno == EINTR) {
+    }
+    trace_child("module_host", job->trace_start, NULL, job->pid, 0, status);
+
+    free(job->output);
+    job->output = NULL;
+    job->pid = -1;
+    job->fd = -1;
+    job->in_fd = -1;
+    job->busy = false;
+}
+
+/*
+ * Evaluate a module in a single bash child. Metadata is stored in fields
+ * (caller frees); alternatives are appended to alts and/or returned raw
+ * when either is non-NULL.
+ */
+static int module_eval(const module_info_t *module, char *fields[FIELD_COUNT],
+                       alternative_list_t *alts, char **raw)
+{
+    eval_job_t job;
+    if (eval_start(&job, module, alts || raw) != 0) {
+        for (size_t i = 0; i < FIELD_COUNT; i++) {
+            fields[i] = NULL;
+        }
+        if (raw) {
+            *raw = NULL;
+        }
+        return -1;
+    }
+
+    eval_drain(&job);
+    eval_finish(&job, fields, alts, raw);
+    return job.timed_out ? -1 : 0;
+}
+
+/*
+ * Ask a module where its extra links should point for an alternative. The
+ * optional extra_link_targets function prints one target per entry of
+ * MODULE_EXTRA_LINKS, in order; an empty line removes that link, and
+ * links past the last line are left unchanged.
+ * Returns the output (caller frees), empty if the function is not defined.
+ */
+static char *module_extra_targets(const module_info_t *module, const char *path,
+                                  const char *name)
+{
+    if (module->declarative) {
+        return spec_extra_targets(module->path, path, name);
+    }
+
+    static const char program[] =
+        "source \"$1\" >/dev/null </dev/null || exit 1\n"
+        "declare -F extra_link_targets >/dev/null || exit 0\n"
+        "extra_link_targets \"$2\" \"$3\" </dev/null\n";
+
+    char *argv[] = {
+        "bash", "-c", (char *)program, "bash",
+        module->path, (char *)path, (char *)name, NULL
+    };
+
+    uint64_t trace_start = trace_begin();
+    spawn_child_t child;
+    if (spawn_with_pipe(&child, "/bin/bash", argv) != 0) {
+        print_error("Failed to start bash for module '%s': %s (spawn: %.2f ms)",
+                    module->name, strerror(child.error), child.spawn_ms);
+        return NULL;
+    }
+
+    eval_job_t job = {
+        .pid = child.pid, .fd = child.out_fd, .in_fd = -1,
+        .module = module->name, .deadline = eval_deadline()
+    };
+    fcntl(job.fd, F_SETFL, fcntl(job.fd, F_GETFL) | O_NONBLOCK);
+    int ret = eval_drain(&job);
+
+    close(job.fd);
+    int status;
+    while (waitpid(job.pid, &status, 0) == -1 && errno == EINTR) {
+    }
+    trace_child("extra_link_targets", trace_start, module->name, job.pid, job.size, status);
+
+    if (ret < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+        free(job.output);
+        return NULL;
+    }
+    if (!job.output) {
+        return strdup("");
+    }
+    job.output[job.size] = '\0';
+    return job.output;
+}
+
+int module_daemon_connect(const switch_config_t *config)
+{
+    if (!config || !config->socket_path || getenv("SWITCH_NO_DAEMON")) {
+        return -1;
+    }
+
+    struct sockaddr_un addr = { .sun_family = AF_UNIX };
+    if (strlen(config->socket_path) >= sizeof(addr.sun_path)) {
+        return -1;
+    }
+    strcpy(addr.sun_path, config->socket_path);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd == -1) {
+        return -1;
+    }
+    if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+        close(fd);
+        return -1;
+    }
+
+    /* Its answers are acted on, so only trust a daemon run by us or root */
+    struct ucred cred;
+    socklen_t cred_len = sizeof(cred);
+    if (getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &cred, &cred_len) != 0 ||
+        (cred.uid != getuid() && cred.uid != 0)) {
+        close(fd);
+        return -1;
+    }
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+
+    g_daemon_fd = fd;
+    return 0;
+}
+
+void module_daemon_disconnect(void)
+{
+    if (g_daemon_fd != -1) {
+        close(g_daemon_fd);
+        g_daemon_fd = -1;
+    }
+}
+
+/*
+ * Ask switchd to evaluate a module. It speaks the module host protocol;
+ * an empty reply means the daemon does not serve this script. Any
+ * failure drops the connection and leaves evaluation to this process.
+ */
+static int daemon_query(const module_info_t *module, char *fields[FIELD_COUNT],
+                        char **raw)
+{
+    if (g_daemon_fd == -1 || strchr(module->path, '\n')) {
+        return -1;
+    }
+
+    size_t len = strlen(module->path) + 4;
+    char *line = malloc(len + 1);
+    if (!line) {
+        return -1;
+    }
+    snprintf(line, len + 1, "%s\n%s\n", module->path, raw ? "1" : "");
+    len = strlen(line);
+
+    eval_job_t reply = { .pid = -1, .fd = g_daemon_fd, .in_fd = -1 };
+    uint64_t trace_start = trace_begin();
+    int ret = -1;
+
+    for (size_t off = 0; off < len;) {
+        ssize_t n = send(g_daemon_fd, line + off, len - off, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            goto out;
+        }
+        off += (size_t)n;
+    }
+
+    /* A module the daemon is stuck on counts against the module's limit */
+    int wait_ms = g_timeout_ms > 0 && g_timeout_ms < DAEMON_TIMEOUT_MS ? g_timeout_ms
+                                                                       : DAEMON_TIMEOUT_MS;
+    for (;;) {
+        struct pollfd pfd = { .fd = g_daemon_fd, .events = POLLIN };
+        int ready = poll(&pfd, 1, wait_ms);
+        if (ready < 0 && errno == EINTR) {
             continue;
         }
+        if (ready <= 0) {
+            goto out;
+        }
 
-        size_t len = strlen(entry->d_name);
-        if (len < 4 || strcmp(entry->d_name + len - 3, ".sh") != 0) {
+        int status = eval_read(&reply);
+        int taken = host_take_reply(&reply, fields, raw);
+        if (taken == 1) {
+            ret = 0;
+            goto out;
+        }
+        if (taken == 2) {
+            /* Not served; the connection stays usable */
+            trace_span("daemon_query", trace_start, "module", module->name);
+            free(line);
+            free(reply.output);
+            return -1;
+        }
+        if (taken < 0 || status != 0) {
+            goto out;
+        }
+    }
+
+out:
+    trace_span("daemon_query", trace_start, "module", module->name);
+    if (ret != 0) {
+        module_daemon_disconnect();
+    }
+    free(line);
+    free(reply.output);
+    return ret;
+}
+
+/* Store evaluated metadata, keeping any field that is already set */
+static void module_store_fields(module_info_t *module, char *fields[FIELD_COUNT])
+{
+    char **slots[FIELD_COUNT] = {
+        [FIELD_DESCRIPTION] = &module->description,
+        [FIELD_CATEGORY]    = &module->category,
+        [FIELD_LINK]        = &module->link_path,
+        [FIELD_EXTRA_LINKS] = &module->extra_links,
+        [FIELD_WATCH]       = &module->watch,
+    };
+
+    for (size_t i = 0; i < FIELD_COUNT; i++) {
+        if (!*slots[i]) {
+            *slots[i] = arena_strdup(module->arena, fields[i]);
+        }
+        free(fields[i]);
+    }
+
+    module->metadata_loaded = true;
+}
+
+/* Store fields and remember them in the cache when the lookup missed */
+static void module_store_evaluated(module_info_t *module, char *fields[FIELD_COUNT],
+                                   const cache_key_t *key, bool cache_miss)
+{
+    if (cache_miss) {
+        metadata_cache_store(&g_cache, module->path, key, fields);
+    }
+    module_store_fields(module, fields);
+}
+
+/*
+ * Try the metadata cache. On a miss, *cache_miss is set when key identifies
+ * the script, so that the evaluated result can be stored under it.
+ */
+static bool module_load_cached(module_info_t *module, cache_key_t *key,
+                               bool *cache_miss)
+{
+    *cache_miss = false;
+    if (!g_cache_enabled) {
+        return false;
+    }
+
+    struct stat st;
+    if (stat(module->path, &st) != 0) {
+        return false;
+    }
+    cache_key_from_stat(key, &st);
+
+    char *fields[FIELD_COUNT];
+    uint64_t trace_start = trace_begin();
+    bool hit = metadata_cache_lookup(&g_cache, module->path, key, fields);
+    trace_span(hit ? "metadata_cache_hit" : "metadata_cache_miss", trace_start,
+               "module", module->name);
+    if (!hit) {
+        *cache_miss = true;
+        return false;
+    }
+
+    module_store_fields(module, fields);
+    return true;
+}
+
+/*
+ * Plain literal assignments are read without starting a shell. Declarative
+ * modules are always resolved here; one that cannot be parsed is left
+ * without metadata rather than handed to bash.
+ */
+static bool module_load_literal(module_info_t *module, const cache_key_t *key,
+                                bool cache_miss)
+{
+    char *fields[FIELD_COUNT];
+    uint64_t trace_start = trace_begin();
+
+    if (module->declarative) {
+        int parsed = spec_read_metadata(module->path, field_keys, FIELD_COUNT, fields);
+        trace_span("spec_parse", trace_start, "module", module->name);
+        if (parsed == 0) {
+            module_store_evaluated(module, fields, key, cache_miss);
+        } else {
+            module_store_fields(module, fields);
+        }
+        return true;
+    }
+
+    script_parse_result_t result = script_parse_vars(module->path, field_vars,
+                                                     FIELD_COUNT, fields);
+    trace_span("literal_parse", trace_start, "module", module->name);
+    if (result != SCRIPT_PARSE_OK) {
+        return false;
+    }
+
+    module_store_evaluated(module, fields, key, cache_miss);
+    return true;
+}
+
+/*
+ * Stamps an alternatives cache entry depends on: the script itself followed
+ * by every MODULE_WATCH path. Returns the number of stamps, 0 if the module
+ * declares nothing to watch.
+ */
+static size_t module_watch_stamps(const module_info_t *module, cache_key_t **stamps)
+{
+    *stamps = NULL;
+    if (!module->watch || !*module->watch) {
+        return 0;
+    }
+
+    size_t count = 2;
+    for (const char *p = module->watch; *p; p++) {
+        count += *p == ':';
+    }
+
+    cache_key_t *keys = calloc(count, sizeof(cache_key_t));
+    char *paths = strdup(module->watch);
+    if (!keys || !paths) {
+        free(keys);
+        free(paths);
+        return 0;
+    }
+
+    size_t n = 0;
+    cache_stamp_path(module->path, &keys[n++]);
+
+    char *saveptr = NULL;
+    for (char *dir = strtok_r(paths, ":", &saveptr); dir;
+         dir = strtok_r(NULL, ":", &saveptr)) {
+        /* Watched paths are inside the root; unresolved ones stay zeroed */
+        struct stat st;
+        if (path_stat(dir, &st, true) == 0) {
+            cache_key_from_stat(&keys[n], &st);
+        }
+        n++;
+    }
+
+    free(paths);
+    *stamps = keys;
+    return n;
+}
+
+static char *alternatives_cache_dir(void)
+{
+    size_t len = strlen(g_cache.dir) + 1 + strlen(ALTERNATIVES_CACHE_SUBDIR) + 1;
+    char *dir = malloc(len);
+    if (dir) {
+        snprintf(dir, len, "%s/%s", g_cache.dir, ALTERNATIVES_CACHE_SUBDIR);
+    }
+    return dir;
+}
+
+/* Cached find_alternatives output, or NULL if stale or absent */
+static char *module_read_cached_alternatives(const module_info_t *module,
+                                             const cache_key_t *stamps, size_t count)
+{
+    char *dir = alternatives_cache_dir();
+    if (!dir) {
+        return NULL;
+    }
+
+    size_t size;
+    uint64_t trace_start = trace_begin();
+    char *output = stamped_cache_read(dir, module->name, stamps, count, &size);
+    trace_span(output ? "alternatives_cache_hit" : "alternatives_cache_miss",
+               trace_start, "module", module->name);
+    free(dir);
+    return output;
+}
+
+static void module_write_cached_alternatives(const module_info_t *module,
+                                             const cache_key_t *stamps, size_t count,
+                                             const char *output)
+{
+    char *dir = alternatives_cache_dir();
+    if (!dir) {
+        return;
+    }
+
+    if (stamped_cache_write(dir, module->name, stamps, count,
+                            output, strlen(output)) != 0) {
+        print_warning("Failed to cache alternatives of '%s'", module->name);
+    }
+    free(dir);
+}
+
+/* Receiver of alternatives parsed while find_alternatives is still running */
+typedef struct {
+    alternative_list_t *list;
+    alternative_fn emit;
+    void *data;
+    size_t emitted;     /* Items of list already passed to emit */
+    bool filled;        /* list holds every evaluated alternative */
+} alternative_sink_t;
+
+static void sink_flush(alternative_sink_t *sink)
+{
+    while (sink->emitted < sink->list->count) {
+        sink->emit(&sink->list->items[sink->emitted++], sink->data);
+    }
+}
+
+/*
+ * Like module_eval() with raw, but metadata is stored as soon as its records
+ * are complete and every alternative is passed to the sink when its line
+ * arrives, instead of after bash exits.
+ */
+static int module_eval_streaming(module_info_t *module, char *fields[FIELD_COUNT],
+                                 char **raw, alternative_sink_t *sink)
+{
+    eval_job_t job;
+    if (eval_start(&job, module, true) != 0) {
+        for (size_t i = 0; i < FIELD_COUNT; i++) {
+            fields[i] = NULL;
+        }
+        *raw = NULL;
+        return -1;
+    }
+
+    size_t consumed = 0;    /* Bytes parsed as metadata or fed to the sink */
+    size_t records = 0;
+    bool streaming = false;
+
+    while (eval_reserve(&job) == 0) {
+        ssize_t n = read(job.fd, job.output + job.size, job.capacity - job.size - 1);
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            if (!eval_wait(&job)) {
+                eval_expire(&job);
+                break;
+            }
+            continue;
+        }
+        if (n < 0 && errno == EINTR) {
             continue;
         }
+        if (n <= 0) {
+            break;
+        }
+        job.size += (size_t)n;
+
+        while (!streaming) {
+            ssize_t span = records < FIELD_COUNT ?
+                netstring_span(job.output + consumed, job.size - consumed) : -1;
+            if (span == 0) {
+                break;
+            }
+            if (span > 0) {
+                consumed += (size_t)span;
+                records++;
+                continue;
+            }
+
+            /* Metadata is complete; what follows is find_alternatives output */
+            char *early[FIELD_COUNT] = { NULL };
+            parse_record(job.output, consumed, early, NULL, NULL);
+            module_store_fields(module, early);
+            streaming = true;
+        }
+
+        if (streaming && consumed < job.size) {
+            alternatives_feed(sink->list, job.output + consumed, job.size - consumed);
+            consumed = job.size;
+            sink_flush(sink);
+        }
+    }
+
+    eval_finish(&job, fields, NULL, raw);
+    if (job.timed_out) {
+        return -1;
+    }
+
+    alternatives_finish(sink->list);
+    sink_flush(sink);
+    sink->filled = true;
+    return 0;
+}
+
+/*
+ * Load metadata and, when raw is non-NULL, the unparsed find_alternatives
+ * output (caller frees). Sources are tried cheapest first: metadata cache,
+ * static parser, cached alternatives, switchd, and finally bash. If bash
+ * runs and sink is non-NULL, alternatives are also parsed into the sink as
+ * they are printed.
+ */
+static int module_load_output(module_info_t *module, char **raw,
+                              alternative_sink_t *sink)
+{
+    if (raw) {
+        *raw = NULL;
+    }
+
+    if (module->metadata_loaded && !raw) {
+        return 0;
+    }
 
-        char path[4096];
-        snprintf(path, sizeof(path), "%s/%s", dir_path, entry->d_name);
+    cache_key_t key = {0};
+    bool cache_miss = false;
+    char *fields[FIELD_COUNT];
 
-        if (!is_executable(path)) {
-            continue;
+    if (!module->metadata_loaded) {
+        bool loaded = module_load_cached(module, &key, &cache_miss) ||
+                      module_load_literal(module, &key, cache_miss);
+        if (loaded && !raw) {
+            return 0;
         }
-
-        char name[256];
-        size_t name_len = len - 3;
-        if (name_len >= sizeof(name)) {
-            name_len = sizeof(name) - 1;
+        if (!loaded && !raw && daemon_query(module, fields, NULL) == 0) {
+            module_store_evaluated(module, fields, &key, cache_miss);
+            return 0;
         }
-        strncpy(name, entry->d_name, name_len);
-        name[name_len] = '\0';
+    }
 
-        bool exists = false;
-        for (size_t i = 0; i < list->count; i++) {
-            if (strcmp(list->modules[i].name, name) == 0) {
-                exists = true;
-                break;
+    /* Declarative modules are cheap enough to evaluate every time */
+    if (module->declarative) {
+        uint64_t trace_start = trace_begin();
+        *raw = spec_find_alternatives(module->path);
+        trace_span("spec_alternatives", trace_start, "module", module->name);
+        return *raw ? 0 : -1;
+    }
+
+    /*
+     * Alternatives are reused while the script and the watched paths are
+     * unchanged. Stamps are taken before evaluating, so a change made
+     * while find_alternatives runs invalidates the entry.
+     */
+    cache_key_t *stamps = NULL;
+    size_t stamp_count = 0;
+    if (raw && g_cache_enabled) {
+        stamp_count = module_watch_stamps(module, &stamps);
+        if (stamp_count && !g_refresh) {
+            *raw = module_read_cached_alternatives(module, stamps, stamp_count);
+            if (*raw) {
+                free(stamps);
+                return 0;
             }
         }
+    }
+
+    if (raw && !g_refresh && daemon_query(module, fields, raw) == 0) {
+        module_store_evaluated(module, fields, &key, cache_miss);
+        free(stamps);
+        return 0;
+    }
+
+    int evaluated = raw && sink ? module_eval_streaming(module, fields, raw, sink)
+                                : module_eval(module, fields, NULL, raw);
+    if (evaluated != 0) {
+        free(stamps);
+        return -1;
+    }
+
+    module_store_evaluated(module, fields, &key, cache_miss);
 
-        if (!exists) {
-            module_list_add(list, name, path, is_user);
+    if (raw && *raw && g_cache_enabled) {
+        /* MODULE_WATCH may only be known now for dynamic scripts */
+        if (!stamps) {
+            stamp_count = module_watch_stamps(module, &stamps);
+        }
+        if (stamp_count) {
+            module_write_cached_alternatives(module, stamps, stamp_count, *raw);
         }
     }
 
-    closedir(dir);
+    free(stamps);
     return 0;
 }
 
-int module_scan(module_list_t *list, const switch_config_t *config)
+int module_load(module_info_t *module, alternative_list_t *alts)
 {
-    if (!list || !config) {
+    if (!module || !module->path) {
         return -1;
     }
 
-    if (config->user_modules_dir) {
-        scan_directory(list, config->user_modules_dir, true);
+    /* Alternatives are evaluated at most once per run */
+    if (alts && module->alternatives) {
+        char *copy = strdup(module->alternatives);
+        if (!copy) {
+            return -1;
+        }
+        alternatives_parse(alts, copy, strlen(copy));
+        return 0;
     }
 
-    if (config->system_modules_dir) {
-        scan_directory(list, config->system_modules_dir, false);
+    char *raw = NULL;
+    if (module_load_output(module, alts ? &raw : NULL, NULL) != 0) {
+        return -1;
     }
 
+    if (raw) {
+        /* The list takes over raw; its entries point into it */
+        module->alternatives = arena_strdup(module->arena, raw);
+        alternatives_parse(alts, raw, strlen(raw));
+    }
     return 0;
 }
 
-const module_info_t *module_find(const module_list_t *list, const char *name)
+int module_load_streaming(module_info_t *module, alternative_list_t *alts,
+                          alternative_fn emit, void *data)
 {
-    if (!list || !name) {
-        return NULL;
+    if (!module || !module->path || !alts || !emit) {
+        return -1;
     }
 
-    for (size_t i = 0; i < list->count; i++) {
-        if (strcmp(list->modules[i].name, name) == 0) {
-            return &list->modules[i];
+    alternative_sink_t sink = { alts, emit, data, 0, false };
+
+    if (module->alternatives) {
+        char *copy = strdup(module->alternatives);
+        if (!copy) {
+            return -1;
         }
+        alternatives_parse(alts, copy, strlen(copy));
+        sink_flush(&sink);
+        return 0;
     }
 
-    return NULL;
-}
-
-static char *read_pipe_output(int fd)
-{
-    char *output = NULL;
-    size_t size = 0;
-    size_t capacity = 0;
-    char buf[256];
-    ssize_t n;
+    char *raw = NULL;
+    if (module_load_output(module, &raw, &sink) != 0) {
+        return -1;
+    }
 
-    while ((n = read(fd, buf, sizeof(buf))) > 0) {
-        if (size + n + 1 > capacity) {
-            capacity = capacity ? capacity * 2 : 256;
-            char *new_output = realloc(output, capacity);
-            if (!new_output) {
-                free(output);
-                return NULL;
-            }
-            output = new_output;
+    if (raw) {
+        module->alternatives = arena_strdup(module->arena, raw);
+        if (sink.filled) {
+            free(raw);
+        } else {
+            /* Cached or answered by switchd: everything is known at once */
+            alternatives_parse(alts, raw, strlen(raw));
         }
-        memcpy(output + size, buf, n);
-        size += n;
     }
+    sink_flush(&sink);
+    return 0;
+}
 
-    if (output) {
-        output[size] = '\0';
-        while (size > 0 && (output[size - 1] == '\n' || output[size - 1] == '\r')) {
-            output[--size] = '\0';
-        }
+int module_load_raw(module_info_t *module, char **raw)
+{
+    if (!module || !module->path || !raw) {
+        return -1;
     }
 
-    return output;
+    return module_load_output(module, raw, NULL);
 }
 
-static char *module_get_var(const module_info_t *module, const char *var_name)
+char *module_format_record(const module_info_t *module, const char *raw, size_t *size)
 {
-    if (!module || !module->path || !var_name) {
-        return NULL;
+    const char *values[FIELD_COUNT] = {
+        [FIELD_DESCRIPTION] = module->description,
+        [FIELD_CATEGORY]    = module->category,
+        [FIELD_LINK]        = module->link_path,
+        [FIELD_EXTRA_LINKS] = module->extra_links,
+        [FIELD_WATCH]       = module->watch,
+    };
+
+    size_t len = raw ? strlen(raw) : 0;
+    for (size_t i = 0; i < FIELD_COUNT; i++) {
+        len += (values[i] ? strlen(values[i]) : 0) + 24;
     }
 
-    int pipefd[2];
-    if (pipe(pipefd) == -1) {
+    char *record = malloc(len + 1);
+    if (!record) {
         return NULL;
     }
 
-    pid_t pid = fork();
-    if (pid == -1) {
-        close(pipefd[0]);
-        close(pipefd[1]);
-        return NULL;
+    size_t off = 0;
+    for (size_t i = 0; i < FIELD_COUNT; i++) {
+        const char *value = values[i] ? values[i] : "";
+        off += (size_t)snprintf(record + off, len + 1 - off, "%zu:%s,",
+                                strlen(value), value);
     }
-
-    if (pid == 0) {
-        close(pipefd[0]);
-        dup2(pipefd[1], STDOUT_FILENO);
-        close(pipefd[1]);
-
-        char cmd[512];
-        snprintf(cmd, sizeof(cmd), "source \"%s\" && echo -n \"$%s\"",
-                 module->path, var_name);
-        execl("/bin/bash", "bash", "-c", cmd, NULL);
-        _exit(1);
+    if (raw) {
+        off += (size_t)snprintf(record + off, len + 1 - off, "%s", raw);
     }
 
-    close(pipefd[1]);
-    char *value = read_pipe_output(pipefd[0]);
-    close(pipefd[0]);
+    *size = off;
+    return record;
+}
 
-    int status;
-    waitpid(pid, &status, 0);
+/* Module waiting for a bash evaluation in module_load_all() */
+typedef struct {
+    module_info_t *module;
+    cache_key_t key;
+    bool cache_miss;
+    cache_key_t *stamps;    /* Alternatives cache stamps taken before evaluating */
+    size_t stamp_count;
+} load_request_t;
+
+/* Store an evaluation's metadata and, when loading them, its alternatives */
+static void load_request_store(load_request_t *request, char *fields[FIELD_COUNT],
+                               char *raw)
+{
+    module_info_t *module = request->module;
+    module_store_evaluated(module, fields, &request->key, request->cache_miss);
+    if (!raw) {
+        return;
+    }
 
-    return value;
+    module->alternatives = arena_strdup(module->arena, raw);
+    if (g_cache_enabled) {
+        if (!request->stamps) {
+            request->stamp_count = module_watch_stamps(module, &request->stamps);
+        }
+        if (request->stamp_count) {
+            module_write_cached_alternatives(module, request->stamps,
+                                             request->stamp_count, raw);
+        }
+    }
+    free(raw);
 }
 
-int module_load_metadata(module_info_t *module)
+/* Evaluate one request in its own child, without a module host */
+static void load_request_eval(load_request_t *request, bool with_alts)
 {
-    if (!module) {
-        return -1;
+    char *fields[FIELD_COUNT];
+    char *raw = NULL;
+    if (module_eval(request->module, fields, NULL, with_alts ? &raw : NULL) == 0) {
+        load_request_store(request, fields, raw);
     }
+}
 
-    if (!module->description) {
-        module->description = module_get_var(module, "MODULE_DESCRIPTION");
-    }
-    if (!module->category) {
-        module->category = module_get_var(module, "MODULE_CATEGORY");
+/*
+ * Resolve a module without bash if possible: metadata from the cache or the
+ * static parser, with alternatives from the declarative evaluator, the
+ * alternatives cache or switchd. Returns true when nothing is left to do.
+ */
+static bool load_request_resolve(load_request_t *request, bool with_alts)
+{
+    module_info_t *module = request->module;
+    bool loaded = module->metadata_loaded ||
+                  module_load_cached(module, &request->key, &request->cache_miss) ||
+                  module_load_literal(module, &request->key, request->cache_miss);
+
+    if (!with_alts || module->alternatives) {
+        if (loaded) {
+            return true;
+        }
+
+        /* switchd may already know the answer */
+        char *fields[FIELD_COUNT];
+        if (daemon_query(module, fields, NULL) == 0) {
+            load_request_store(request, fields, NULL);
+            return true;
+        }
+        return false;
     }
-    if (!module->link_path) {
-        module->link_path = module_get_var(module, "MODULE_LINK");
+
+    char *raw = NULL;
+    if (module->declarative) {
+        uint64_t trace_start = trace_begin();
+        raw = spec_find_alternatives(module->path);
+        trace_span("spec_alternatives", trace_start, "module", module->name);
+    } else if (loaded && g_cache_enabled) {
+        request->stamp_count = module_watch_stamps(module, &request->stamps);
+        if (request->stamp_count && !g_refresh) {
+            raw = module_read_cached_alternatives(module, request->stamps,
+                                                  request->stamp_count);
+        }
     }
-    if (!module->extra_links) {
-        module->extra_links = module_get_var(module, "MODULE_EXTRA_LINKS");
+    if (raw || module->declarative) {
+        if (raw) {
+            module->alternatives = arena_strdup(module->arena, raw);
+            free(raw);
+        }
+        return true;
     }
 
-    return 0;
+    char *fields[FIELD_COUNT];
+    if (!g_refresh && daemon_query(module, fields, &raw) == 0) {
+        load_request_store(request, fields, raw);
+        return true;
+    }
+    return false;
 }
 
-int module_get_alternatives(const module_info_t *module, alternative_list_t *list)
+/*
+ * Evaluate every module that needs it, up to jobs at a time; with_alts
+ * also loads and memoizes alternatives.
+ */
+static int load_all(module_list_t *list, int jobs, bool with_alts)
 {
-    if (!module || !list || !module->path) {
+    if (!list) {
         return -1;
     }
+    if (list->count == 0) {
+        return 0;
+    }
+    if (jobs < 1) {
+        jobs = 1;
+    }
 
-    list->items = malloc(INITIAL_CAPACITY * sizeof(alternative_t));
-    if (!list->items) {
+    load_request_t *requests = calloc(list->count, sizeof(load_request_t));
+    if (!requests) {
         return -1;
     }
-    list->count = 0;
-    list->capacity = INITIAL_CAPACITY;
 
-    int pipefd[2];
-    if (pipe(pipefd) == -1) {
-        free(list->items);
-        return -1;
+    /* Anything the caches, the static parser or switchd resolve needs no shell */
+    size_t request_count = 0;
+    for (size_t i = 0; i < list->count; i++) {
+        load_request_t *request = &requests[request_count];
+        request->module = &list->modules[i];
+        if (load_request_resolve(request, with_alts)) {
+            free(request->stamps);
+            memset(request, 0, sizeof(*request));
+            continue;
+        }
+        request_count++;
+    }
+
+    if (request_count == 0) {
+        free(requests);
+        return 0;
     }
 
-    pid_t pid = fork();
-    if (pid == -1) {
-        close(pipefd[0]);
-        close(pipefd[1]);
-        free(list->items);
+    /*
+     * Up to jobs module hosts answer the remaining requests, so bash starts
+     * once per host rather than once per module.
+     */
+    size_t host_count = (size_t)jobs < request_count ? (size_t)jobs : request_count;
+    eval_job_t *hosts = calloc(host_count, sizeof(eval_job_t));
+    struct pollfd *pfds = calloc(host_count, sizeof(struct pollfd));
+    size_t *slots = calloc(host_count, sizeof(size_t));
+    if (!hosts || !pfds || !slots) {
+        free(hosts);
+        free(pfds);
+        free(slots);
+        free(requests);
         return -1;
     }
 
-    if (pid == 0) {
-        close(pipefd[0]);
-        dup2(pipefd[1], STDOUT_FILENO);
-        close(pipefd[1]);
+    /* A host that dies must not take switch down with SIGPIPE */
+    struct sigaction ignore = { .sa_handler = SIG_IGN };
+    struct sigaction saved_pipe;
+    sigemptyset(&ignore.sa_mask);
+    sigaction(SIGPIPE, &ignore, &saved_pipe);
 
-        char cmd[512];
-        snprintf(cmd, sizeof(cmd), "source \"%s\" && find_alternatives", module->path);
-        execl("/bin/bash", "bash", "-c", cmd, NULL);
-        _exit(1);
+    size_t live = 0;
+    for (size_t h = 0; h < host_count; h++) {
+        if (host_start(&hosts[live]) == 0) {
+            live++;
+        }
     }
 
-    close(pipefd[1]);
-    char *output = read_pipe_output(pipefd[0]);
-    close(pipefd[0]);
+    int ret = 0;
+    size_t next = 0;
 
-    int status;
-    waitpid(pid, &status, 0);
+    while (live > 0) {
+        /* Hand out work to idle hosts */
+        for (size_t h = 0; h < live && next < request_count; h++) {
+            if (hosts[h].busy) {
+                continue;
+            }
+            while (next < request_count &&
+                   host_send(&hosts[h], requests[next].module, next, with_alts) != 0) {
+                load_request_eval(&requests[next++], with_alts);
+            }
+            if (hosts[h].busy) {
+                next++;
+            }
+        }
 
-    if (!output) {
-        return 0;
-    }
+        size_t waiting = 0;
+        uint64_t deadline = 0;
+        for (size_t h = 0; h < live; h++) {
+            if (hosts[h].busy) {
+                pfds[waiting].fd = hosts[h].fd;
+                pfds[waiting].events = POLLIN;
+                pfds[waiting].revents = 0;
+                slots[waiting++] = h;
+                if (hosts[h].deadline && (!deadline || hosts[h].deadline < deadline)) {
+                    deadline = hosts[h].deadline;
+                }
+            }
+        }
+        if (waiting == 0) {
+            break;
+        }
 
-    /* Parse output: path|name|priority */
-    char *line = strtok(output, "\n");
-    while (line) {
-        char *path = line;
-        char *name = strchr(path, '|');
-        if (!name) {
-            line = strtok(NULL, "\n");
-            continue;
+        if (poll(pfds, waiting, deadline_timeout(deadline)) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            ret = -1;
+            break;
         }
-        *name++ = '\0';
 
-        char *priority_str = strchr(name, '|');
-        int priority = 10;
-        if (priority_str) {
-            *priority_str++ = '\0';
-            priority = atoi(priority_str);
+        for (size_t w = waiting; w-- > 0;) {
+            if (!pfds[w].revents) {
+                continue;
+            }
+
+            eval_job_t *host = &hosts[slots[w]];
+            int status = eval_read(host);
+
+            char *fields[FIELD_COUNT];
+            char *raw = NULL;
+            int reply = host_take_reply(host, fields, with_alts ? &raw : NULL);
+            if (reply > 0) {
+                load_request_store(&requests[host->request], fields, raw);
+                continue;
+            }
+            if (reply == 0 && status == 0) {
+                continue;
+            }
+
+            /* Host exited or misbehaved: retry its module on its own */
+            load_request_eval(&requests[host->request], with_alts);
+            host_stop(host);
+            hosts[slots[w]] = hosts[--live];
         }
 
-        if (list->count >= list->capacity) {
-            size_t new_cap = list->capacity * 2;
-            alternative_t *new_items = realloc(list->items, new_cap * sizeof(alternative_t));
-            if (!new_items) {
-                break;
+        /* A host stuck past its deadline is killed; a new one takes over */
+        uint64_t now = trace_now();
+        for (size_t h = live; h-- > 0;) {
+            eval_job_t *host = &hosts[h];
+            if (!host->busy || !host->deadline || now < host->deadline) {
+                continue;
+            }
+            eval_expire(host);
+            host_stop(host);
+            if (next >= request_count || host_start(host) != 0) {
+                hosts[h] = hosts[--live];
             }
-            list->items = new_items;
-            list->capacity = new_cap;
         }
+    }
+
+    for (size_t h = 0; h < live; h++) {
+        if (hosts[h].busy) {
+            load_request_eval(&requests[hosts[h].request], with_alts);
+        }
+        host_stop(&hosts[h]);
+    }
+
+    /* Whatever could not be handed to a host is evaluated directly */
+    while (next < request_count) {
+        load_request_eval(&requests[next++], with_alts);
+    }
+
+    sigaction(SIGPIPE, &saved_pipe, NULL);
+
+    for (size_t i = 0; i < request_count; i++) {
+        free(requests[i].stamps);
+    }
+    free(hosts);
+    free(pfds);
+    free(slots);
+    free(requests);
+    return ret;
+}
+
+int module_load_all(module_list_t *list, int jobs)
+{
+    return load_all(list, jobs, false);
+}
+
+int module_load_all_alternatives(module_list_t *list, int jobs)
+{
+    return load_all(list, jobs, true);
+}
+
+int module_load_metadata(module_info_t *module)
+{
+    return module_load(module, NULL);
+}
+
+int module_get_alternatives(const module_info_t *module, alternative_list_t *list)
+{
+    if (!module || !list || !module->path) {
+        return -1;
+    }
+
+    list->items = NULL;
+    list->count = 0;
+    list->capacity = 0;
+
+    if (module->declarative) {
+        char *raw = spec_find_alternatives(module->path);
+        if (!raw) {
+            return -1;
+        }
+        alternatives_parse(list, raw, strlen(raw));
+        return 0;
+    }
 
-        list->items[list->count].path = strdup(path);
-        list->items[list->count].name = strdup(name);
-        list->items[list->count].priority = priority;
-        list->count++;
+    char *fields[FIELD_COUNT];
+    if (module_eval(module, fields, list, NULL) != 0) {
+        return -1;
+    }
 
-        line = strtok(NULL, "\n");
+    for (size_t i = 0; i < FIELD_COUNT; i++) {
+        free(fields[i]);
     }
 
-    free(output);
     return 0;
 }
 
-void module_print_list(const module_list_t *list)
+void module_print_list(module_list_t *list, int jobs)
 {
     if (!list) {
         return;
@@ -389,12 +1859,16 @@ void module_print_list(const module_list_t *list)
         return;
     }
 
+    uint64_t trace_start = trace_begin();
+    module_load_all(list, jobs);
+    trace_span("load_all", trace_start, NULL, NULL);
+
+    /* The registry is kept sorted by name */
+    trace_start = trace_begin();
     printf("Available modules:\n");
 
     for (size_t i = 0; i < list->count; i++) {
-        module_info_t *module = &list->modules[i];
-
-        module_load_metadata(module);
+        const module_info_t *module = &list->modules[i];
 
         printf("  %s%-16s%s",
                color_get(COLOR_GREEN),
@@ -411,70 +1885,105 @@ void module_print_list(const module_list_t *list)
 
         printf("\n");
     }
+
+    trace_span("output", trace_start, NULL, NULL);
 }
 
-int module_action_list(const module_info_t *module)
+/* State of a list action while its rows are printed */
+typedef struct {
+    const module_info_t *module;
+    path_id_t current;  /* File the link points to, if has_current */
+    bool has_current;
+    bool started;       /* Header printed */
+} list_output_t;
+
+/* Resolve the link's current target and print the header, once */
+static void list_output_start(list_output_t *out)
 {
-    if (!module) {
-        return -1;
+    if (out->started) {
+        return;
     }
+    out->started = true;
 
-    module_info_t *m = (module_info_t *)module;
-    module_load_metadata(m);
+    const module_info_t *module = out->module;
+    uint64_t trace_start = trace_begin();
+    char buf[1];
+    out->has_current = path_readlink(module->link_path, buf, sizeof(buf)) > 0 &&
+                       path_identity(module->link_path, &out->current);
+    trace_span("resolve_current", trace_start, "module", module->name);
 
-    if (!m->link_path) {
-        print_error("Module does not define a link path");
+    printf("Available alternatives for %s%s%s:\n",
+           color_get(COLOR_CYAN), module->name, color_get(COLOR_RESET));
+    printf("  Link: %s\n\n", module->link_path);
+}
+
+static void list_output_row(const alternative_t *alt, void *data)
+{
+    list_output_t *out = data;
+    if (!out->module->link_path) {
+        return;
+    }
+    list_output_start(out);
+
+    /* Same file as the link's target, however either path is spelled */
+    path_id_t id;
+    if (out->has_current && path_identity(alt->path, &id) &&
+        path_id_equal(&id, &out->current)) {
+        printf("  %s[*]%s ", color_get(COLOR_GREEN), color_get(COLOR_RESET));
+    } else {
+        printf("  [ ] ");
+    }
+
+    printf("%s%-12s%s  %s  (priority: %d",
+           color_get(COLOR_BOLD),
+           alt->name,
+           color_get(COLOR_RESET),
+           alt->path,
+           alt->priority);
+    if (alt->version) {
+        printf(", version: %s", alt->version);
+    }
+    printf(")\n");
+
+    /* Rows may be minutes apart when find_alternatives is slow */
+    fflush(stdout);
+}
+
+int module_action_list(const module_info_t *module, bool sorted)
+{
+    if (!module) {
         return -1;
     }
 
+    module_info_t *m = (module_info_t *)module;
     alternative_list_t alts = {0};
-    if (module_get_alternatives(module, &alts) != 0) {
+    list_output_t out = { .module = module };
+
+    int ret = sorted ? module_load(m, &alts)
+                     : module_load_streaming(m, &alts, list_output_row, &out);
+    if (ret != 0) {
         print_error("Failed to get alternatives");
+        alternative_list_free(&alts);
         return -1;
     }
 
-    if (alts.count == 0) {
-        printf("No alternatives found for %s\n", module->name);
+    if (!m->link_path) {
+        print_error("Module does not define a link path");
         alternative_list_free(&alts);
-        return 0;
+        return -1;
     }
 
-    /* Get current target */
-    char *current = NULL;
-    if (file_exists(m->link_path) || is_executable(m->link_path)) {
-        char buf[4096];
-        ssize_t len = readlink(m->link_path, buf, sizeof(buf) - 1);
-        if (len > 0) {
-            buf[len] = '\0';
-            current = realpath(m->link_path, NULL);
+    if (sorted) {
+        alternatives_sort(&alts);
+        for (size_t i = 0; i < alts.count; i++) {
+            list_output_row(&alts.items[i], &out);
         }
     }
 
-    printf("Available alternatives for %s%s%s:\n",
-           color_get(COLOR_CYAN), module->name, color_get(COLOR_RESET));
-    printf("  Link: %s\n\n", m->link_path);
-
-    for (size_t i = 0; i < alts.count; i++) {
-        char *real_path = realpath(alts.items[i].path, NULL);
-        bool is_current = current && real_path && strcmp(current, real_path) == 0;
-
-        if (is_current) {
-            printf("  %s[*]%s ", color_get(COLOR_GREEN), color_get(COLOR_RESET));
-        } else {
-            printf("  [ ] ");
-        }
-
-        printf("%s%-12s%s  %s  (priority: %d)\n",
-               color_get(COLOR_BOLD),
-               alts.items[i].name,
-               color_get(COLOR_RESET),
-               alts.items[i].path,
-               alts.items[i].priority);
-
-        free(real_path);
+    if (alts.count == 0) {
+        printf("No alternatives found for %s\n", module->name);
     }
 
-    free(current);
     alternative_list_free(&alts);
     return 0;
 }
@@ -500,17 +2009,16 @@ int module_action_show(const module_info_t *module)
     printf("\n");
 
     char buf[4096];
-    ssize_t len = readlink(m->link_path, buf, sizeof(buf) - 1);
+    ssize_t len = path_readlink(m->link_path, buf, sizeof(buf) - 1);
 
     if (len > 0) {
         buf[len] = '\0';
-        char *real = realpath(m->link_path, NULL);
+        const char *real = path_resolved(m->link_path);
 
         printf("Link: %s\n", m->link_path);
         printf("  -> %s\n", buf);
         if (real) {
             printf("  => %s%s%s\n", color_get(COLOR_GREEN), real, color_get(COLOR_RESET));
-            free(real);
         }
     } else {
         printf("Link: %s\n", m->link_path);
@@ -527,36 +2035,53 @@ int module_action_set(const module_info_t *module, const char *target)
     }
 
     module_info_t *m = (module_info_t *)module;
-    module_load_metadata(m);
 
-    if (!m->link_path) {
-        print_error("Module does not define a link path");
+    /* Metadata and alternatives come from a single evaluation */
+    alternative_list_t alts = {0};
+    if (module_load(m, &alts) != 0) {
+        print_error("Failed to get alternatives");
         return -1;
     }
 
-    /* Find target in alternatives */
-    alternative_list_t alts = {0};
-    if (module_get_alternatives(module, &alts) != 0) {
-        print_error("Failed to get alternatives");
+    if (!m->link_path) {
+        print_error("Module does not define a link path");
+        alternative_list_free(&alts);
         return -1;
     }
 
     char *target_path = NULL;
+    char *target_name = NULL;
 
     /* Match by name or path */
-    for (size_t i = 0; i < alts.count; i++) {
+    const alternative_t *match = NULL;
+    for (size_t i = 0; i < alts.count && !match; i++) {
         if (strcmp(alts.items[i].name, target) == 0 ||
             strcmp(alts.items[i].path, target) == 0) {
-            target_path = strdup(alts.items[i].path);
-            break;
+            match = &alts.items[i];
+        }
+    }
+
+    /* A path to the same file as an alternative, e.g. through a symlink */
+    path_id_t target_id;
+    if (!match && target[0] == '/' && path_identity(target, &target_id)) {
+        for (size_t i = 0; i < alts.count && !match; i++) {
+            path_id_t id;
+            if (path_identity(alts.items[i].path, &id) && path_id_equal(&id, &target_id)) {
+                match = &alts.items[i];
+            }
         }
     }
 
+    if (match) {
+        target_path = strdup(match->path);
+        target_name = strdup(match->name);
+    }
+
     alternative_list_free(&alts);
 
     /* If not found in list, try as absolute path */
     if (!target_path) {
-        if (target[0] == '/' && is_executable(target)) {
+        if (target[0] == '/' && path_executable(target)) {
             target_path = strdup(target);
         } else {
             print_error("Alternative '%s' not found", target);
@@ -565,37 +2090,126 @@ int module_action_set(const module_info_t *module, const char *target)
         }
     }
 
-    /* Check permissions */
-    char *link_dir = strdup(m->link_path);
-    char *last_slash = strrchr(link_dir, '/');
-    if (last_slash) {
-        *last_slash = '\0';
+    /* The managed link first, then every extra link the module names */
+    size_t max_changes = 1;
+    for (const char *p = m->extra_links; p && *p; p++) {
+        max_changes += *p == ':';
     }
-
-    if (access(link_dir, W_OK) != 0) {
-        print_error("Insufficient permissions to modify %s", m->link_path);
-        printf("Try running with sudo.\n");
-        free(link_dir);
+    max_changes += m->extra_links ? 1 : 0;
+
+    link_change_t *changes = calloc(max_changes, sizeof(link_change_t));
+    char *extra_links = m->extra_links ? strdup(m->extra_links) : NULL;
+    char *extra_targets = NULL;
+    if (!changes || (m->extra_links && !extra_links)) {
+        print_error("Out of memory");
+        free(changes);
+        free(extra_links);
         free(target_path);
+        free(target_name);
         return 1;
     }
-    free(link_dir);
 
-    /* Remove old link */
-    unlink(m->link_path);
+    size_t count = 0;
+    changes[count++] = (link_change_t){ m->link_path, target_path };
+
+    if (extra_links) {
+        extra_targets = module_extra_targets(m, target_path,
+                                             target_name ? target_name : "");
+        if (!extra_targets) {
+            print_error("Failed to get extra link targets for '%s'", target);
+            free(changes);
+            free(extra_links);
+            free(target_path);
+            free(target_name);
+            return 1;
+        }
 
-    /* Create new symlink */
-    if (symlink(target_path, m->link_path) != 0) {
-        print_error("Failed to create symlink: %s", strerror(errno));
-        free(target_path);
-        return 1;
+        char *next_target = extra_targets;
+        char *saveptr = NULL;
+        for (char *link = strtok_r(extra_links, ":", &saveptr); link;
+             link = strtok_r(NULL, ":", &saveptr)) {
+            /* A line that is empty removes the link; no line keeps it */
+            char *link_target = next_target && *next_target ?
+                                strsep(&next_target, "\n") : NULL;
+            if (link_target) {
+                changes[count++] = (link_change_t){ link, *link_target ? link_target : NULL };
+            } else {
+                print_warning("%s left unchanged: %s gives no target for '%s'",
+                              link, module->name, target);
+            }
+        }
     }
 
-    print_success("Setting %s to %s\n", module->name, target);
-    printf("  %s -> %s\n", m->link_path, target_path);
+    int ret = 0;
+    size_t failed = 0;
+    uint64_t trace_start = trace_begin();
+    int replaced = links_replace(changes, count, &failed);
+    int err = errno;
+    trace_span("links_replace", trace_start, "module", module->name);
 
+    for (size_t i = 0; i < count; i++) {
+        path_forget(changes[i].link);
+    }
+    if (replaced != 0) {
+        if (err == EEXIST) {
+            print_error("%s exists and is not a symlink", changes[failed].link);
+        } else {
+            print_error("Failed to update %s: %s", changes[failed].link, strerror(err));
+        }
+        if (err == EACCES || err == EPERM) {
+            printf("Try running with sudo.\n");
+        }
+        printf("No links were changed.\n");
+        ret = 1;
+    } else {
+        print_success("Setting %s to %s\n", module->name, target);
+        for (size_t i = 0; i < count; i++) {
+            if (changes[i].target) {
+                printf("  %s -> %s\n", changes[i].link, changes[i].target);
+            } else {
+                printf("  %s removed\n", changes[i].link);
+            }
+        }
+    }
+
+    free(changes);
+    free(extra_links);
+    free(extra_targets);
     free(target_path);
-    return 0;
+    free(target_name);
+    return ret;
+}
+
+int module_action_best(const module_info_t *module)
+{
+    if (!module) {
+        return -1;
+    }
+
+    alternative_list_t alts = {0};
+    if (module_load((module_info_t *)module, &alts) != 0) {
+        print_error("Failed to get alternatives");
+        return -1;
+    }
+
+    const alternative_t *best = alternatives_best(&alts);
+    if (!best) {
+        print_error("No alternatives found for %s", module->name);
+        alternative_list_free(&alts);
+        return 1;
+    }
+
+    /* The path is unambiguous where names may repeat */
+    char *target = strdup(best->path);
+    alternative_list_free(&alts);
+    if (!target) {
+        print_error("Out of memory");
+        return 1;
+    }
+
+    int ret = module_action_set(module, target);
+    free(target);
+    return ret;
 }
 
 int module_action_help(const module_info_t *module)
@@ -622,6 +2236,7 @@ int module_action_help(const module_info_t *module)
     printf("  list              List available alternatives\n");
     printf("  show              Show current configuration\n");
     printf("  set <target>      Set the alternative\n");
+    printf("  best              Set the highest ranked alternative\n");
     printf("  help              Show this help\n");
 
     if (m->link_path) {
@@ -632,5 +2247,9 @@ int module_action_help(const module_info_t *module)
         printf("Extra links: %s\n", m->extra_links);
     }
 
+    if (m->watch) {
+        printf("Watched paths: %s\n", m->watch);
+    }
+
     return 0;
 }
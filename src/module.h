@@ -12,28 +12,17 @@
 #ifndef SWITCH_MODULE_H
 #define SWITCH_MODULE_H
 
+#include "alternatives.h"
+#include "arena.h"
 #include "config.h"
 #include <stdbool.h>
 #include <stddef.h>
+#include <stdint.h>
 
 /* Maximum number of modules/alternatives */
 #define MAX_MODULES 256
 #define MAX_ALTERNATIVES 128
 
-/* Alternative entry */
-typedef struct {
-    char *path;      /* Full path to the binary */
-    char *name;      /* Display name */
-    int priority;    /* Priority (higher = preferred) */
-} alternative_t;
-
-/* Alternatives list */
-typedef struct {
-    alternative_t *items;
-    size_t count;
-    size_t capacity;
-} alternative_list_t;
-
 /* Module information structure */
 typedef struct {
     char *name;         /* Module name (without .sh extension) */
@@ -42,14 +31,25 @@ typedef struct {
     char *category;     /* Module category */
     char *link_path;    /* Path to the managed symlink */
     char *extra_links;  /* Additional managed links (colon-separated) */
+    char *watch;        /* Paths whose changes invalidate alternatives */
+    char *alternatives; /* find_alternatives output memoized by module_load() */
     bool is_user;       /* True if from user directory */
+    bool declarative;   /* .switch file evaluated without a shell */
+    bool metadata_loaded; /* True once the script has been evaluated */
+    arena_t *arena;     /* Arena owning every string above */
 } module_info_t;
 
-/* Module list structure */
+/*
+ * Module registry: modules sorted by name after module_scan(), a hash
+ * index on the name and one arena holding all of their strings.
+ */
 typedef struct {
     module_info_t *modules;
     size_t count;
     size_t capacity;
+    arena_t *arena;
+    uint32_t *index;        /* Open addressing; slots hold module index + 1 */
+    size_t index_capacity;  /* Power of two */
 } module_list_t;
 
 /* Initialize module list */
@@ -58,28 +58,85 @@ int module_list_init(module_list_t *list);
 /* Free module list */
 void module_list_free(module_list_t *list);
 
-/* Scan directories for modules */
+/* Scan directories for modules; the list ends up sorted by name */
 int module_scan(module_list_t *list, const switch_config_t *config);
 
 /* Find module by name */
 const module_info_t *module_find(const module_list_t *list, const char *name);
 
+/*
+ * Find module by name, adding it to the list from <user_dir>/<name>.sh or
+ * else <system_dir>/<name>.sh without scanning either directory. Modules
+ * added this way are not kept in name order.
+ */
+const module_info_t *module_lookup(module_list_t *list, const switch_config_t *config,
+                                   const char *name);
+
+/*
+ * Apply config->refresh and config->timeout_ms to module evaluations and
+ * open the persistent metadata cache (disabled by SWITCH_NO_CACHE)
+ */
+int module_cache_init(const switch_config_t *config);
+
+/* Write new cache entries back and close the cache */
+void module_cache_finish(void);
+
+/* Connect to switchd if its socket exists (disabled by SWITCH_NO_DAEMON) */
+int module_daemon_connect(const switch_config_t *config);
+
+/* Close the switchd connection */
+void module_daemon_disconnect(void);
+
 /* Load module metadata (description, link_path, etc.) */
 int module_load_metadata(module_info_t *module);
 
+/*
+ * Load metadata and, if alts is non-NULL, alternatives in one evaluation.
+ * Alternatives are memoized in the module for the rest of the run.
+ */
+int module_load(module_info_t *module, alternative_list_t *alts);
+
+/* Called with each alternative as soon as it is known */
+typedef void (*alternative_fn)(const alternative_t *alt, void *data);
+
+/*
+ * Like module_load() with alts, also calling emit for every alternative in
+ * order. When find_alternatives has to run, metadata is stored before the
+ * first call and rows are passed on while the script is still printing.
+ */
+int module_load_streaming(module_info_t *module, alternative_list_t *alts,
+                          alternative_fn emit, void *data);
+
+/* Load metadata and the unparsed find_alternatives output (caller frees, not memoized) */
+int module_load_raw(module_info_t *module, char **raw);
+
+/* Serialize metadata and raw alternatives as an evaluation record */
+char *module_format_record(const module_info_t *module, const char *raw, size_t *size);
+
+/* Load metadata of every module, running up to jobs evaluations at once */
+int module_load_all(module_list_t *list, int jobs);
+
+/*
+ * Like module_load_all(), but alternatives are loaded as well and memoized
+ * in each module's alternatives field, from the same evaluation
+ */
+int module_load_all_alternatives(module_list_t *list, int jobs);
+
 /* Get alternatives from module */
 int module_get_alternatives(const module_info_t *module, alternative_list_t *list);
 
-/* Free alternatives list */
-void alternative_list_free(alternative_list_t *list);
-
-/* Print list of all modules */
-void module_print_list(const module_list_t *list);
+/* Print list of all modules, sorted by name */
+void module_print_list(module_list_t *list, int jobs);
 
-/* Actions */
-int module_action_list(const module_info_t *module);
+/*
+ * Actions. list prints each alternative as it arrives; with sorted it
+ * buffers them and prints them in order of preference (see
+ * alternative_compare()). best sets the most preferred alternative.
+ */
+int module_action_list(const module_info_t *module, bool sorted);
 int module_action_show(const module_info_t *module);
 int module_action_set(const module_info_t *module, const char *target);
+int module_action_best(const module_info_t *module);
 int module_action_help(const module_info_t *module);
 
 #endif /* SWITCH_MODULE_H */
@@ -0,0 +1,276 @@
+/*
+ * switch - alternatives management tool for NurOS
+ * Copyright (C) 2026 AnmiTaliDev <anmitali198@gmail.com>
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ */
+
+/* O_PATH for resolving inside the root */
+#define _GNU_SOURCE
+
+#include "pathid.h"
+#include "utils.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <linux/openat2.h>
+#include <sys/syscall.h>
+
+#define INITIAL_CAPACITY 64
+
+typedef struct {
+    char *path;
+    bool stat_done;
+    bool stat_ok;
+    path_id_t id;
+    bool resolve_done;
+    char *resolved;
+} path_entry_t;
+
+/* Open addressing on the path; the table is kept at most half full */
+static path_entry_t *g_entries = NULL;
+static size_t g_capacity = 0;
+static size_t g_count = 0;
+
+/* Directory fd of root_dir(), opened on first use */
+static int g_root_fd = -1;
+
+/*
+ * RESOLVE_IN_ROOT keeps absolute symlinks such as "/etc/alternatives/vi"
+ * in the image; kernels without openat2() fall back to the host path.
+ */
+int path_open(const char *path, int flags)
+{
+    flags |= O_CLOEXEC;
+    if (!*root_dir()) {
+        return open(path, flags);
+    }
+
+    if (g_root_fd == -1) {
+        g_root_fd = open(root_dir(), O_PATH | O_DIRECTORY | O_CLOEXEC);
+        if (g_root_fd == -1) {
+            return -1;
+        }
+    }
+
+    struct open_how how = { .flags = (uint64_t)flags, .resolve = RESOLVE_IN_ROOT };
+    int fd = (int)syscall(SYS_openat2, g_root_fd, path, &how, sizeof(how));
+    if (fd == -1 && errno == ENOSYS) {
+        char *full = rooted_path(path);
+        fd = full ? open(full, flags) : -1;
+        free(full);
+    }
+    return fd;
+}
+
+int path_stat(const char *path, struct stat *st, bool follow)
+{
+    if (!*root_dir()) {
+        return follow ? stat(path, st) : lstat(path, st);
+    }
+
+    int fd = path_open(path, O_PATH | (follow ? 0 : O_NOFOLLOW));
+    if (fd == -1) {
+        return -1;
+    }
+    int ret = fstat(fd, st);
+    close(fd);
+    return ret;
+}
+
+ssize_t path_readlink(const char *path, char *buf, size_t size)
+{
+    if (!*root_dir()) {
+        return readlink(path, buf, size);
+    }
+
+    /* An O_PATH fd of the link itself reads with an empty name */
+    int fd = path_open(path, O_PATH | O_NOFOLLOW);
+    if (fd == -1) {
+        return -1;
+    }
+    ssize_t len = readlinkat(fd, "", buf, size);
+    int saved = errno;
+    close(fd);
+    errno = saved;
+    return len;
+}
+
+bool path_executable(const char *path)
+{
+    if (!*root_dir()) {
+        return access(path, X_OK) == 0;
+    }
+
+    /* Permission bits stand in for access(), which would follow host links */
+    struct stat st;
+    return path_stat(path, &st, true) == 0 && S_ISREG(st.st_mode) &&
+           (st.st_mode & (S_IXUSR | S_IXGRP | S_IXOTH));
+}
+
+/* realpath() inside the root, as a path inside it (caller frees) */
+static char *resolve_in_root(const char *path)
+{
+    const char *root = root_dir();
+    if (!*root) {
+        return realpath(path, NULL);
+    }
+
+    int fd = path_open(path, O_PATH);
+    if (fd == -1) {
+        return NULL;
+    }
+
+    char proc[32];
+    char host[4096];
+    snprintf(proc, sizeof(proc), "/proc/self/fd/%d", fd);
+    ssize_t len = readlink(proc, host, sizeof(host) - 1);
+    close(fd);
+    if (len <= 0) {
+        return NULL;
+    }
+    host[len] = '\0';
+
+    size_t root_len = strlen(root);
+    if (strncmp(host, root, root_len) != 0 || (host[root_len] && host[root_len] != '/')) {
+        return NULL;
+    }
+    return strdup(host[root_len] ? host + root_len : "/");
+}
+
+/* FNV-1a */
+static uint64_t hash_path(const char *path)
+{
+    uint64_t hash = 0xcbf29ce484222325u;
+    for (const unsigned char *p = (const unsigned char *)path; *p; p++) {
+        hash = (hash ^ *p) * 0x100000001b3u;
+    }
+    return hash;
+}
+
+static path_entry_t *find_slot(path_entry_t *entries, size_t capacity, const char *path)
+{
+    size_t mask = capacity - 1;
+    size_t slot = (size_t)hash_path(path) & mask;
+    while (entries[slot].path && strcmp(entries[slot].path, path) != 0) {
+        slot = (slot + 1) & mask;
+    }
+    return &entries[slot];
+}
+
+static int grow(void)
+{
+    size_t capacity = g_capacity ? g_capacity * 2 : INITIAL_CAPACITY;
+    path_entry_t *entries = calloc(capacity, sizeof(path_entry_t));
+    if (!entries) {
+        return -1;
+    }
+
+    for (size_t i = 0; i < g_capacity; i++) {
+        if (g_entries[i].path) {
+            *find_slot(entries, capacity, g_entries[i].path) = g_entries[i];
+        }
+    }
+
+    free(g_entries);
+    g_entries = entries;
+    g_capacity = capacity;
+    return 0;
+}
+
+/* Entry for path, created empty if needed; NULL on allocation failure */
+static path_entry_t *lookup(const char *path)
+{
+    if ((g_count + 1) * 2 > g_capacity && grow() != 0) {
+        return NULL;
+    }
+
+    path_entry_t *entry = find_slot(g_entries, g_capacity, path);
+    if (!entry->path) {
+        entry->path = strdup(path);
+        if (!entry->path) {
+            return NULL;
+        }
+        g_count++;
+    }
+    return entry;
+}
+
+bool path_identity(const char *path, path_id_t *id)
+{
+    path_entry_t *entry = lookup(path);
+    if (!entry) {
+        struct stat st;
+        if (path_stat(path, &st, true) != 0) {
+            return false;
+        }
+        *id = (path_id_t){ st.st_dev, st.st_ino };
+        return true;
+    }
+
+    if (!entry->stat_done) {
+        struct stat st;
+        entry->stat_ok = path_stat(path, &st, true) == 0;
+        if (entry->stat_ok) {
+            entry->id = (path_id_t){ st.st_dev, st.st_ino };
+        }
+        entry->stat_done = true;
+    }
+
+    *id = entry->id;
+    return entry->stat_ok;
+}
+
+const char *path_resolved(const char *path)
+{
+    path_entry_t *entry = lookup(path);
+    if (!entry) {
+        return NULL;
+    }
+
+    if (!entry->resolve_done) {
+        entry->resolved = resolve_in_root(path);
+        entry->resolve_done = true;
+    }
+    return entry->resolved;
+}
+
+void path_forget(const char *path)
+{
+    if (!g_entries) {
+        return;
+    }
+
+    path_entry_t *entry = find_slot(g_entries, g_capacity, path);
+    if (entry->path) {
+        free(entry->resolved);
+        entry->resolved = NULL;
+        entry->resolve_done = false;
+        entry->stat_done = false;
+    }
+}
+
+void path_memo_clear(void)
+{
+    for (size_t i = 0; i < g_capacity; i++) {
+        free(g_entries[i].path);
+        free(g_entries[i].resolved);
+    }
+    free(g_entries);
+    g_entries = NULL;
+    g_capacity = 0;
+    g_count = 0;
+
+    if (g_root_fd != -1) {
+        close(g_root_fd);
+        g_root_fd = -1;
+    }
+}
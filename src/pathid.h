@@ -0,0 +1,62 @@
+/*
+ * switch - alternatives management tool for NurOS
+ * Copyright (C) 2026 AnmiTaliDev <anmitali198@gmail.com>
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ */
+
+#ifndef SWITCH_PATHID_H
+#define SWITCH_PATHID_H
+
+#include <stdbool.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+/* The file a path finally resolves to */
+typedef struct {
+    dev_t dev;
+    ino_t ino;
+} path_id_t;
+
+/*
+ * Per-run memo of path lookups, so that list, show and set look at each
+ * link and alternative once however often they are compared.
+ *
+ * Paths are seen from inside root_dir(): symlinks, absolute ones included,
+ * resolve without leaving it, and resolved paths are relative to it.
+ */
+
+/* stat() path (following symlinks) into *id; false if it does not resolve */
+bool path_identity(const char *path, path_id_t *id);
+
+/* realpath() of path, owned by the memo; NULL if it does not resolve */
+const char *path_resolved(const char *path);
+
+static inline bool path_id_equal(const path_id_t *a, const path_id_t *b)
+{
+    return a->dev == b->dev && a->ino == b->ino;
+}
+
+/* open() a path inside the root; O_CLOEXEC is implied */
+int path_open(const char *path, int flags);
+
+/* stat() (follow) or lstat() a path inside the root, without the memo */
+int path_stat(const char *path, struct stat *st, bool follow);
+
+/* readlink() a path inside the root */
+ssize_t path_readlink(const char *path, char *buf, size_t size);
+
+/* Whether path inside the root is an executable file */
+bool path_executable(const char *path);
+
+/* Drop what is known about path, after it was changed */
+void path_forget(const char *path);
+
+/* Release the memo */
+void path_memo_clear(void);
+
+#endif /* SWITCH_PATHID_H */
@@ -0,0 +1,282 @@
+/*
+ * switch - alternatives management tool for NurOS
+ * Copyright (C) 2026 AnmiTaliDev <anmitali198@gmail.com>
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+#define _DEFAULT_SOURCE
+
+#include "probe.h"
+#include "cache.h"
+#include "process.h"
+#include "trace.h"
+#include "utils.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <errno.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+#define VERSIONS_CACHE_SUBDIR "versions"
+
+/* Output beyond this is ignored; versions are printed first */
+#define PROBE_OUTPUT_MAX 4096
+
+typedef struct {
+    const char *binary;
+    char *version;          /* Result; NULL until known */
+    bool probed;            /* version came from running the binary */
+    bool stat_ok;
+    cache_key_t key;
+    char name[17];          /* Cache entry: hash of flag and path */
+    pid_t pid;
+    int fd;
+    char output[PROBE_OUTPUT_MAX + 1];
+    size_t size;
+    uint64_t start;         /* trace_now() at spawn */
+} probe_t;
+
+/* FNV-1a over flag, a NUL and path */
+static void probe_cache_name(probe_t *probe, const char *flag)
+{
+    uint64_t hash = 0xcbf29ce484222325u;
+    for (const char *parts[] = { flag, probe->binary }, **part = parts;
+         part < parts + 2; part++) {
+        const unsigned char *p = (const unsigned char *)*part;
+        do {
+            hash = (hash ^ *p) * 0x100000001b3u;
+        } while (*p++);
+    }
+    snprintf(probe->name, sizeof(probe->name), "%016llx", (unsigned long long)hash);
+}
+
+/*
+ * First token of output that starts with a digit, tokens being runs of
+ * letters, digits and "._+-": "17.0.2" from 'openjdk version "17.0.2"',
+ * "3.11.2" from "Python 3.11.2".
+ */
+static char *extract_version(const char *output)
+{
+    for (const char *p = output; *p; p++) {
+        bool boundary = p == output ||
+                        !(isalnum((unsigned char)p[-1]) || strchr("._+-", p[-1]));
+        if (!boundary || *p < '0' || *p > '9') {
+            continue;
+        }
+
+        size_t len = 0;
+        while (p[len] && (isalnum((unsigned char)p[len]) || strchr("._+-", p[len]))) {
+            len++;
+        }
+        while (len > 1 && strchr("._+-", p[len - 1])) {
+            len--;
+        }
+        return strndup(p, len);
+    }
+    return strdup("");
+}
+
+/* Reap a finished or killed probe and record its result */
+static void probe_finish(probe_t *probe, bool timed_out)
+{
+    close(probe->fd);
+    probe->fd = -1;
+
+    int status;
+    while (waitpid(probe->pid, &status, 0) == -1 && errno == EINTR) {
+    }
+    trace_child("probe", probe->start, probe->binary, probe->pid, probe->size, status);
+
+    if (timed_out) {
+        print_warning("%s did not report its version within %d ms",
+                      probe->binary, PROBE_TIMEOUT_MS);
+        probe->version = strdup("");
+        return;
+    }
+
+    probe->output[probe->size] = '\0';
+    probe->version = extract_version(probe->output);
+    probe->probed = true;
+}
+
+static int probe_start(probe_t *probe, const char *flag)
+{
+    char *argv[] = { (char *)probe->binary, (char *)flag, NULL };
+    spawn_child_t child;
+
+    probe->start = trace_now();
+    if (spawn_captured(&child, probe->binary, argv) != 0) {
+        print_warning("Cannot run %s: %s", probe->binary, strerror(child.error));
+        probe->version = strdup("");
+        return -1;
+    }
+
+    probe->pid = child.pid;
+    probe->fd = child.out_fd;
+    probe->size = 0;
+    return 0;
+}
+
+/* Run every probe without a version, at most jobs at a time */
+static void run_probes(probe_t *probes, size_t count, const char *flag, int jobs)
+{
+    probe_t **running = calloc((size_t)jobs, sizeof(probe_t *));
+    struct pollfd *pfds = calloc((size_t)jobs, sizeof(struct pollfd));
+    if (!running || !pfds) {
+        free(running);
+        free(pfds);
+        return;
+    }
+
+    size_t next = 0;
+    int active = 0;
+
+    for (;;) {
+        while (active < jobs && next < count) {
+            probe_t *probe = &probes[next++];
+            if (!probe->version && probe_start(probe, flag) == 0) {
+                running[active++] = probe;
+            }
+        }
+        if (active == 0) {
+            break;
+        }
+
+        /* Wait until the oldest probe would time out */
+        uint64_t now = trace_now();
+        uint64_t deadline = UINT64_MAX;
+        for (int i = 0; i < active; i++) {
+            pfds[i] = (struct pollfd){ .fd = running[i]->fd, .events = POLLIN };
+            uint64_t end = running[i]->start + (uint64_t)PROBE_TIMEOUT_MS * 1000000u;
+            deadline = end < deadline ? end : deadline;
+        }
+        int timeout = deadline > now ? (int)((deadline - now) / 1000000u) + 1 : 0;
+
+        if (poll(pfds, (nfds_t)active, timeout) < 0 && errno != EINTR) {
+            break;
+        }
+
+        now = trace_now();
+        for (int i = active - 1; i >= 0; i--) {
+            probe_t *probe = running[i];
+            bool done = false;
+
+            if (pfds[i].revents) {
+                char discard[512];
+                bool full = probe->size >= PROBE_OUTPUT_MAX;
+                char *buf = full ? discard : probe->output + probe->size;
+                size_t room = full ? sizeof(discard) : PROBE_OUTPUT_MAX - probe->size;
+                ssize_t n = read(probe->fd, buf, room);
+                if (n > 0 && !full) {
+                    probe->size += (size_t)n;
+                }
+                done = n == 0 || (n < 0 && errno != EINTR && errno != EAGAIN);
+                if (done) {
+                    probe_finish(probe, false);
+                }
+            }
+
+            if (!done && now >= probe->start + (uint64_t)PROBE_TIMEOUT_MS * 1000000u) {
+                spawn_kill(probe->pid);
+                probe_finish(probe, true);
+                done = true;
+            }
+
+            if (done) {
+                running[i] = running[--active];
+            }
+        }
+    }
+
+    /* Only reached with probes left on allocation or poll failure */
+    for (int i = 0; i < active; i++) {
+        spawn_kill(running[i]->pid);
+        probe_finish(running[i], true);
+    }
+
+    free(running);
+    free(pfds);
+}
+
+static char *versions_cache_dir(const switch_config_t *config)
+{
+    if (!config->cache_dir || getenv("SWITCH_NO_CACHE")) {
+        return NULL;
+    }
+
+    size_t len = strlen(config->cache_dir) + 1 + strlen(VERSIONS_CACHE_SUBDIR) + 1;
+    char *dir = malloc(len);
+    if (dir) {
+        snprintf(dir, len, "%s/%s", config->cache_dir, VERSIONS_CACHE_SUBDIR);
+    }
+    return dir;
+}
+
+int probe_versions(const switch_config_t *config, const char *flag,
+                   char *const *binaries, size_t count)
+{
+    if (!config || !flag || (!binaries && count > 0)) {
+        return -1;
+    }
+
+    probe_t *probes = calloc(count ? count : 1, sizeof(probe_t));
+    if (!probes) {
+        return -1;
+    }
+
+    char *dir = versions_cache_dir(config);
+    uint64_t trace_start = trace_begin();
+
+    for (size_t i = 0; i < count; i++) {
+        probe_t *probe = &probes[i];
+        probe->binary = binaries[i];
+        probe->fd = -1;
+
+        struct stat st;
+        probe->stat_ok = stat(probe->binary, &st) == 0;
+        if (!probe->stat_ok) {
+            probe->version = strdup("");
+            continue;
+        }
+
+        cache_key_from_stat(&probe->key, &st);
+        probe_cache_name(probe, flag);
+        if (dir && !config->refresh) {
+            size_t size;
+            probe->version = stamped_cache_read(dir, probe->name, &probe->key, 1, &size);
+        }
+    }
+    trace_span("probe_cache", trace_start, NULL, NULL);
+
+    run_probes(probes, count, flag, config->jobs > 0 ? config->jobs : 1);
+
+    int ret = 0;
+    for (size_t i = 0; i < count; i++) {
+        probe_t *probe = &probes[i];
+        if (dir && probe->probed && probe->version &&
+            stamped_cache_write(dir, probe->name, &probe->key, 1,
+                                probe->version, strlen(probe->version)) != 0) {
+            print_warning("Failed to cache the version of %s", probe->binary);
+        }
+
+        printf("%s\n", probe->version ? probe->version : "");
+        ret = probe->version ? ret : -1;
+        free(probe->version);
+    }
+
+    free(dir);
+    free(probes);
+    return ret;
+}
@@ -0,0 +1,34 @@
+/*
+ * switch - alternatives management tool for NurOS
+ * Copyright (C) 2026 AnmiTaliDev <anmitali198@gmail.com>
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ */
+
+#ifndef SWITCH_PROBE_H
+#define SWITCH_PROBE_H
+
+#include "config.h"
+#include <stddef.h>
+
+/* Default argument that makes a binary print its version */
+#define PROBE_DEFAULT_FLAG "--version"
+
+/* A probe still running after this long is killed and reports no version */
+#define PROBE_TIMEOUT_MS 10000
+
+/*
+ * Run each binary with flag, up to config->jobs at once, and print the
+ * first version number in its output (stdout and stderr), one line per
+ * binary in argument order; the line is empty when none is found.
+ * Results are cached under the cache directory until the binary's
+ * device, inode, size or mtime changes. Returns 0 on success.
+ */
+int probe_versions(const switch_config_t *config, const char *flag,
+                   char *const *binaries, size_t count);
+
+#endif /* SWITCH_PROBE_H */
@@ -0,0 +1,179 @@
+/*
+ * switch - alternatives management tool for NurOS
+ * Copyright (C) 2026 AnmiTaliDev <anmitali198@gmail.com>
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+#define _DEFAULT_SOURCE
+
+#include "process.h"
+#include <errno.h>
+#include <signal.h>
+#include <fcntl.h>
+#include <spawn.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+extern char **environ;
+
+static unsigned long g_spawn_count = 0;
+static bool g_process_groups = false;
+
+static double elapsed_ms(const struct timespec *start)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double)(now.tv_sec - start->tv_sec) * 1000.0 +
+           (double)(now.tv_nsec - start->tv_nsec) / 1000000.0;
+}
+
+static int open_pipe(int fds[2])
+{
+    if (pipe(fds) == -1) {
+        return -1;
+    }
+    fcntl(fds[0], F_SETFD, FD_CLOEXEC);
+    fcntl(fds[1], F_SETFD, FD_CLOEXEC);
+    return 0;
+}
+
+/* How the child's standard descriptors are connected */
+enum {
+    SPAWN_STDIN_PIPE = 1 << 0,   /* stdin is a pipe from the parent */
+    SPAWN_STDIN_NULL = 1 << 1,   /* stdin reads /dev/null */
+    SPAWN_STDERR_OUT = 1 << 2    /* stderr goes to the stdout pipe */
+};
+
+static int spawn_piped(spawn_child_t *child, const char *path,
+                       char *const argv[], int flags)
+{
+    bool with_stdin = flags & SPAWN_STDIN_PIPE;
+
+    memset(child, 0, sizeof(*child));
+    child->pid = -1;
+    child->in_fd = -1;
+    child->out_fd = -1;
+
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    int outfd[2];
+    int infd[2] = { -1, -1 };
+    if (open_pipe(outfd) != 0) {
+        child->error = errno;
+        child->spawn_ms = elapsed_ms(&start);
+        return -1;
+    }
+    if (with_stdin && open_pipe(infd) != 0) {
+        child->error = errno;
+        close(outfd[0]);
+        close(outfd[1]);
+        child->spawn_ms = elapsed_ms(&start);
+        return -1;
+    }
+
+    posix_spawn_file_actions_t actions;
+    posix_spawnattr_t attr;
+    sigset_t sigdefault;
+    sigemptyset(&sigdefault);
+    sigaddset(&sigdefault, SIGPIPE);
+
+    int err = posix_spawn_file_actions_init(&actions);
+    if (err == 0) {
+        err = posix_spawnattr_init(&attr);
+        if (err == 0) {
+            err = posix_spawnattr_setsigdefault(&attr, &sigdefault);
+            if (err == 0 && g_process_groups) {
+                err = posix_spawnattr_setpgroup(&attr, 0);
+            }
+            if (err == 0) {
+                short spawn_flags = POSIX_SPAWN_SETSIGDEF;
+                if (g_process_groups) {
+                    spawn_flags |= POSIX_SPAWN_SETPGROUP;
+                }
+                err = posix_spawnattr_setflags(&attr, spawn_flags);
+            }
+            if (err == 0) {
+                err = posix_spawn_file_actions_adddup2(&actions, outfd[1], STDOUT_FILENO);
+            }
+            if (err == 0 && with_stdin) {
+                err = posix_spawn_file_actions_adddup2(&actions, infd[0], STDIN_FILENO);
+            }
+            if (err == 0 && (flags & SPAWN_STDIN_NULL)) {
+                err = posix_spawn_file_actions_addopen(&actions, STDIN_FILENO,
+                                                       "/dev/null", O_RDONLY, 0);
+            }
+            if (err == 0 && (flags & SPAWN_STDERR_OUT)) {
+                err = posix_spawn_file_actions_adddup2(&actions, outfd[1], STDERR_FILENO);
+            }
+            if (err == 0) {
+                err = posix_spawn(&child->pid, path, &actions, &attr, argv, environ);
+            }
+            posix_spawnattr_destroy(&attr);
+        }
+        posix_spawn_file_actions_destroy(&actions);
+    }
+
+    close(outfd[1]);
+    if (with_stdin) {
+        close(infd[0]);
+    }
+    child->spawn_ms = elapsed_ms(&start);
+
+    if (err != 0) {
+        close(outfd[0]);
+        if (with_stdin) {
+            close(infd[1]);
+        }
+        child->pid = -1;
+        child->error = err;
+        return -1;
+    }
+
+    child->out_fd = outfd[0];
+    child->in_fd = infd[1];
+    g_spawn_count++;
+    return 0;
+}
+
+int spawn_with_pipe(spawn_child_t *child, const char *path, char *const argv[])
+{
+    return spawn_piped(child, path, argv, 0);
+}
+
+int spawn_coprocess(spawn_child_t *child, const char *path, char *const argv[])
+{
+    return spawn_piped(child, path, argv, SPAWN_STDIN_PIPE);
+}
+
+int spawn_captured(spawn_child_t *child, const char *path, char *const argv[])
+{
+    return spawn_piped(child, path, argv, SPAWN_STDIN_NULL | SPAWN_STDERR_OUT);
+}
+
+void spawn_set_process_groups(bool enabled)
+{
+    g_process_groups = enabled;
+}
+
+void spawn_kill(pid_t pid)
+{
+    if (pid <= 0) {
+        return;
+    }
+    if (!g_process_groups || kill(-pid, SIGKILL) != 0) {
+        kill(pid, SIGKILL);
+    }
+}
+
+unsigned long spawn_count(void)
+{
+    return g_spawn_count;
+}
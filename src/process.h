@@ -0,0 +1,59 @@
+/*
+ * switch - alternatives management tool for NurOS
+ * Copyright (C) 2026 AnmiTaliDev <anmitali198@gmail.com>
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ */
+
+#ifndef SWITCH_PROCESS_H
+#define SWITCH_PROCESS_H
+
+#include <stdbool.h>
+#include <sys/types.h>
+
+/* Child process with its stdout (and optionally stdin) connected to pipes */
+typedef struct {
+    pid_t pid;
+    int in_fd;          /* Write end of the child's stdin, or -1 */
+    int out_fd;         /* Read end of the child's stdout (close-on-exec) */
+    int error;          /* errno of a failed spawn */
+    double spawn_ms;    /* Time spent starting the child */
+} spawn_child_t;
+
+/*
+ * Start path with argv via posix_spawn, which avoids copying the parent's
+ * page tables. The child's stdout is a pipe; every other descriptor the
+ * parent opened close-on-exec stays private, and SIGPIPE is reset to its
+ * default action. Returns 0 on success; on
+ * failure child->error and child->spawn_ms describe what went wrong.
+ */
+int spawn_with_pipe(spawn_child_t *child, const char *path, char *const argv[]);
+
+/* Like spawn_with_pipe(), but the child's stdin is a pipe as well */
+int spawn_coprocess(spawn_child_t *child, const char *path, char *const argv[]);
+
+/*
+ * Like spawn_with_pipe(), but stderr goes to the same pipe as stdout and
+ * stdin reads /dev/null, for running arbitrary programs whose output is
+ * inspected.
+ */
+int spawn_captured(spawn_child_t *child, const char *path, char *const argv[]);
+
+/*
+ * Start later children in their own process group, so that spawn_kill()
+ * also reaches whatever they started. Off by default: such children do
+ * not receive terminal signals like Ctrl-C.
+ */
+void spawn_set_process_groups(bool enabled);
+
+/* SIGKILL a child and, with process groups enabled, its whole group */
+void spawn_kill(pid_t pid);
+
+/* Number of children started successfully by this process */
+unsigned long spawn_count(void);
+
+#endif /* SWITCH_PROCESS_H */
@@ -0,0 +1,432 @@
+/*
+ * switch - alternatives management tool for NurOS
+ * Copyright (C) 2026 AnmiTaliDev <anmitali198@gmail.com>
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ */
+
+/* getdents64() and statx need the GNU extensions */
+#define _GNU_SOURCE
+
+#include "scan.h"
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+
+/* Directory entries are read in chunks of this size */
+#define DENTS_BUFFER (32 * 1024)
+
+/* Submission queue size; larger directories are checked in several rounds */
+#define URING_ENTRIES 256
+
+static unsigned long g_syscalls = 0;
+
+/* A name in the pool and the access it needs: X_OK or R_OK */
+typedef struct {
+    size_t offset;
+    int mode;
+} candidate_t;
+
+/* File names that may be modules, NUL-separated in one buffer */
+typedef struct {
+    char *pool;
+    size_t pool_size;
+    size_t pool_capacity;
+    candidate_t *items;
+    size_t count;
+    size_t capacity;
+} candidates_t;
+
+static int candidates_add(candidates_t *c, const char *name, size_t len, int mode)
+{
+    if (c->count == c->capacity) {
+        size_t new_capacity = c->capacity ? c->capacity * 2 : 64;
+        candidate_t *items = realloc(c->items, new_capacity * sizeof(candidate_t));
+        if (!items) {
+            return -1;
+        }
+        c->items = items;
+        c->capacity = new_capacity;
+    }
+
+    if (c->pool_size + len + 1 > c->pool_capacity) {
+        size_t new_capacity = c->pool_capacity ? c->pool_capacity * 2 : 4096;
+        while (new_capacity < c->pool_size + len + 1) {
+            new_capacity *= 2;
+        }
+        char *pool = realloc(c->pool, new_capacity);
+        if (!pool) {
+            return -1;
+        }
+        c->pool = pool;
+        c->pool_capacity = new_capacity;
+    }
+
+    memcpy(c->pool + c->pool_size, name, len + 1);
+    c->items[c->count++] = (candidate_t){ c->pool_size, mode };
+    c->pool_size += len + 1;
+    return 0;
+}
+
+static bool has_suffix(const char *name, size_t len, const char *suffix)
+{
+    size_t suffix_len = strlen(suffix);
+    return len > suffix_len && strcmp(name + len - suffix_len, suffix) == 0;
+}
+
+/* Read every entry of dirfd, keeping visible module names that may be files */
+static int collect_candidates(int dirfd, candidates_t *c)
+{
+    char *buf = malloc(DENTS_BUFFER);
+    if (!buf) {
+        return -1;
+    }
+
+    int ret = 0;
+    for (;;) {
+        ssize_t n = getdents64(dirfd, buf, DENTS_BUFFER);
+        g_syscalls++;
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            ret = n < 0 ? -1 : 0;
+            break;
+        }
+
+        for (ssize_t off = 0; off < n; ) {
+            const struct dirent64 *entry = (const struct dirent64 *)(buf + off);
+            off += entry->d_reclen;
+
+            if (entry->d_name[0] == '.') {
+                continue;
+            }
+            /* Symlinks and unknown types are resolved by the access check */
+            if (entry->d_type != DT_REG && entry->d_type != DT_LNK &&
+                entry->d_type != DT_UNKNOWN) {
+                continue;
+            }
+
+            size_t len = strlen(entry->d_name);
+            int mode;
+            if (has_suffix(entry->d_name, len, ".sh")) {
+                mode = X_OK;
+            } else if (has_suffix(entry->d_name, len, ".switch")) {
+                mode = R_OK;
+            } else {
+                continue;
+            }
+            if (candidates_add(c, entry->d_name, len, mode) != 0) {
+                free(buf);
+                return -1;
+            }
+        }
+    }
+
+    free(buf);
+    return ret;
+}
+
+static void check_faccessat(int dirfd, const candidates_t *c, bool *usable)
+{
+    for (size_t i = 0; i < c->count; i++) {
+        usable[i] = faccessat(dirfd, c->pool + c->items[i].offset,
+                                  c->items[i].mode, 0) == 0;
+        g_syscalls++;
+    }
+}
+
+/* Mapped io_uring instance */
+typedef struct {
+    int fd;
+    unsigned entries;
+    unsigned *sq_tail;
+    unsigned *sq_mask;
+    unsigned *sq_array;
+    unsigned *cq_head;
+    unsigned *cq_tail;
+    unsigned *cq_mask;
+    struct io_uring_sqe *sqes;
+    struct io_uring_cqe *cqes;
+    void *sq_ring;
+    void *cq_ring;
+    size_t sq_ring_size;
+    size_t cq_ring_size;
+    size_t sqes_size;
+} uring_t;
+
+static void uring_close(uring_t *ring)
+{
+    if (ring->sqes && ring->sqes != MAP_FAILED) {
+        munmap(ring->sqes, ring->sqes_size);
+        g_syscalls++;
+    }
+    if (ring->cq_ring && ring->cq_ring != MAP_FAILED && ring->cq_ring != ring->sq_ring) {
+        munmap(ring->cq_ring, ring->cq_ring_size);
+        g_syscalls++;
+    }
+    if (ring->sq_ring && ring->sq_ring != MAP_FAILED) {
+        munmap(ring->sq_ring, ring->sq_ring_size);
+        g_syscalls++;
+    }
+    close(ring->fd);
+    g_syscalls++;
+}
+
+/* Set up a ring; fails where io_uring is missing or disabled */
+static int uring_open(uring_t *ring)
+{
+    memset(ring, 0, sizeof(*ring));
+
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    ring->fd = (int)syscall(__NR_io_uring_setup, URING_ENTRIES, &params);
+    g_syscalls++;
+    if (ring->fd < 0) {
+        return -1;
+    }
+
+    ring->entries = params.sq_entries;
+    ring->sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    ring->cq_ring_size = params.cq_off.cqes +
+                         params.cq_entries * sizeof(struct io_uring_cqe);
+    ring->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+
+    bool single_mmap = params.features & IORING_FEAT_SINGLE_MMAP;
+    if (single_mmap && ring->cq_ring_size > ring->sq_ring_size) {
+        ring->sq_ring_size = ring->cq_ring_size;
+    }
+
+    ring->sq_ring = mmap(NULL, ring->sq_ring_size, PROT_READ | PROT_WRITE,
+                         MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQ_RING);
+    g_syscalls++;
+    if (ring->sq_ring == MAP_FAILED) {
+        uring_close(ring);
+        return -1;
+    }
+
+    if (single_mmap) {
+        ring->cq_ring = ring->sq_ring;
+    } else {
+        ring->cq_ring = mmap(NULL, ring->cq_ring_size, PROT_READ | PROT_WRITE,
+                             MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_CQ_RING);
+        g_syscalls++;
+        if (ring->cq_ring == MAP_FAILED) {
+            uring_close(ring);
+            return -1;
+        }
+    }
+
+    ring->sqes = mmap(NULL, ring->sqes_size, PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQES);
+    g_syscalls++;
+    if (ring->sqes == MAP_FAILED) {
+        uring_close(ring);
+        return -1;
+    }
+
+    char *sq = ring->sq_ring;
+    char *cq = ring->cq_ring;
+    ring->sq_tail = (unsigned *)(sq + params.sq_off.tail);
+    ring->sq_mask = (unsigned *)(sq + params.sq_off.ring_mask);
+    ring->sq_array = (unsigned *)(sq + params.sq_off.array);
+    ring->cq_head = (unsigned *)(cq + params.cq_off.head);
+    ring->cq_tail = (unsigned *)(cq + params.cq_off.tail);
+    ring->cq_mask = (unsigned *)(cq + params.cq_off.ring_mask);
+    ring->cqes = (struct io_uring_cqe *)(cq + params.cq_off.cqes);
+    return 0;
+}
+
+/* Credentials access(2) checks against: the real user and groups */
+typedef struct {
+    uid_t uid;
+    gid_t gid;
+    gid_t *groups;
+    int group_count;
+} access_creds_t;
+
+static bool creds_in_group(const access_creds_t *creds, gid_t gid)
+{
+    if (gid == creds->gid) {
+        return true;
+    }
+    for (int i = 0; i < creds->group_count; i++) {
+        if (creds->groups[i] == gid) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/*
+ * access(mode) for X_OK or R_OK decided from statx results. ACLs and
+ * noexec mounts are not considered, which does not matter for ordinary
+ * module directories.
+ */
+static bool statx_access(const struct statx *stx, int mode, const access_creds_t *creds)
+{
+    if (!S_ISREG(stx->stx_mode)) {
+        return false;
+    }
+    /* Permission bits for the owner; group and other bits are shifted right */
+    unsigned owner_bit = mode == X_OK ? S_IXUSR : S_IRUSR;
+    if (creds->uid == 0) {
+        return mode == R_OK || (stx->stx_mode & (S_IXUSR | S_IXGRP | S_IXOTH));
+    }
+    if (stx->stx_uid == creds->uid) {
+        return stx->stx_mode & owner_bit;
+    }
+    if (creds_in_group(creds, stx->stx_gid)) {
+        return stx->stx_mode & (owner_bit >> 3);
+    }
+    return stx->stx_mode & (owner_bit >> 6);
+}
+
+/*
+ * Check candidates with statx requests submitted through io_uring, a ring
+ * at a time, instead of one faccessat() each. Returns -1 if io_uring or its
+ * statx operation is unavailable.
+ */
+static int check_uring(int dirfd, const candidates_t *c, bool *usable)
+{
+    uring_t ring;
+    if (uring_open(&ring) != 0) {
+        return -1;
+    }
+
+    access_creds_t creds = { getuid(), getgid(), NULL, 0 };
+    int group_count = getgroups(0, NULL);
+    g_syscalls += 3;
+    if (group_count > 0) {
+        creds.groups = malloc((size_t)group_count * sizeof(gid_t));
+        if (creds.groups) {
+            creds.group_count = getgroups(group_count, creds.groups);
+            g_syscalls++;
+        }
+    }
+
+    size_t batch = c->count < ring.entries ? c->count : ring.entries;
+    struct statx *results = malloc(batch * sizeof(struct statx));
+    int ret = results && creds.group_count >= 0 ? 0 : -1;
+    bool unsupported = false;
+
+    for (size_t base = 0; ret == 0 && !unsupported && base < c->count; base += batch) {
+        unsigned n = (unsigned)(c->count - base < batch ? c->count - base : batch);
+        unsigned tail = *ring.sq_tail;
+
+        for (unsigned i = 0; i < n; i++) {
+            unsigned slot = (tail + i) & *ring.sq_mask;
+            struct io_uring_sqe *sqe = &ring.sqes[slot];
+            memset(sqe, 0, sizeof(*sqe));
+            sqe->opcode = IORING_OP_STATX;
+            sqe->fd = dirfd;
+            sqe->addr = (uint64_t)(uintptr_t)(c->pool + c->items[base + i].offset);
+            sqe->len = STATX_TYPE | STATX_MODE | STATX_UID | STATX_GID;
+            sqe->off = (uint64_t)(uintptr_t)&results[i];
+            sqe->statx_flags = AT_STATX_SYNC_AS_STAT;
+            sqe->user_data = i;
+            ring.sq_array[slot] = slot;
+        }
+        __atomic_store_n(ring.sq_tail, tail + n, __ATOMIC_RELEASE);
+
+        unsigned pending = n;
+        unsigned completed = 0;
+        while (completed < n - pending || (ret == 0 && completed < n)) {
+            /* After an error, only wait for what the kernel already took */
+            int submitted = (int)syscall(__NR_io_uring_enter, ring.fd,
+                                         ret == 0 ? pending : 0, 1,
+                                         IORING_ENTER_GETEVENTS, NULL, 0);
+            g_syscalls++;
+            if (submitted < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                if (ret != 0) {
+                    /* Requests may still write into results; never free it */
+                    results = NULL;
+                    break;
+                }
+                ret = -1;
+                continue;
+            }
+            pending -= ret == 0 ? (unsigned)submitted : 0;
+
+            unsigned head = *ring.cq_head;
+            unsigned cq_tail = __atomic_load_n(ring.cq_tail, __ATOMIC_ACQUIRE);
+            for (; head != cq_tail; head++) {
+                const struct io_uring_cqe *cqe = &ring.cqes[head & *ring.cq_mask];
+                size_t i = (size_t)cqe->user_data;
+                if (cqe->res == -EINVAL || cqe->res == -EOPNOTSUPP) {
+                    /* Kernels before 5.6 know io_uring but not statx */
+                    unsupported = true;
+                }
+                usable[base + i] = cqe->res == 0 &&
+                                       statx_access(&results[i], c->items[base + i].mode,
+                                                    &creds);
+                completed++;
+            }
+            __atomic_store_n(ring.cq_head, head, __ATOMIC_RELEASE);
+        }
+    }
+
+    /* results stay allocated until every submitted request has completed */
+    uring_close(&ring);
+    free(results);
+    free(creds.groups);
+    return unsupported ? -1 : ret;
+}
+
+int scan_scripts(const char *dir_path, scan_fn fn, void *data)
+{
+    int dirfd = open(dir_path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    g_syscalls++;
+    if (dirfd == -1) {
+        return errno == ENOENT || errno == ENOTDIR ? 0 : -1;
+    }
+
+    candidates_t c = {0};
+    int ret = collect_candidates(dirfd, &c);
+
+    bool *usable = NULL;
+    if (ret == 0 && c.count > 0) {
+        usable = calloc(c.count, sizeof(bool));
+        ret = usable ? 0 : -1;
+    }
+
+    if (ret == 0 && c.count > 0) {
+        if (c.count < SCAN_URING_MIN || check_uring(dirfd, &c, usable) != 0) {
+            check_faccessat(dirfd, &c, usable);
+        }
+
+        for (size_t i = 0; i < c.count; i++) {
+            if (usable[i]) {
+                const char *name = c.pool + c.items[i].offset;
+                fn(name, strlen(name), data);
+            }
+        }
+    }
+
+    free(usable);
+    free(c.items);
+    free(c.pool);
+    close(dirfd);
+    g_syscalls++;
+    return ret;
+}
+
+unsigned long scan_syscall_count(void)
+{
+    return g_syscalls;
+}
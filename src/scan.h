@@ -0,0 +1,36 @@
+/*
+ * switch - alternatives management tool for NurOS
+ * Copyright (C) 2026 AnmiTaliDev <anmitali198@gmail.com>
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ */
+
+#ifndef SWITCH_SCAN_H
+#define SWITCH_SCAN_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/* Directories with at least this many candidates are checked through io_uring */
+#define SCAN_URING_MIN 512
+
+/* Called with the file name of each module found */
+typedef void (*scan_fn)(const char *file_name, size_t len, void *data);
+
+/*
+ * Call fn for every executable "*.sh" script and readable "*.switch" file
+ * in dir_path that is not hidden, in directory order. Entries are read
+ * through one directory fd; d_type skips anything that cannot be a module,
+ * and access is checked relative to the fd. A missing directory is not an
+ * error.
+ */
+int scan_scripts(const char *dir_path, scan_fn fn, void *data);
+
+/* Number of system calls made by scan_scripts() in this process */
+unsigned long scan_syscall_count(void);
+
+#endif /* SWITCH_SCAN_H */
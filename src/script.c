@@ -0,0 +1,435 @@
+/*
+ * switch - alternatives management tool for NurOS
+ * Copyright (C) 2026 AnmiTaliDev <anmitali198@gmail.com>
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+#define _DEFAULT_SOURCE
+
+#include "script.h"
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+/* Read position inside the mapped script */
+typedef struct {
+    const char *p;
+    const char *end;
+} cursor_t;
+
+static bool is_blank(char c)
+{
+    return c == ' ' || c == '\t';
+}
+
+static bool is_name_start(char c)
+{
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_';
+}
+
+static bool is_name_char(char c)
+{
+    return is_name_start(c) || (c >= '0' && c <= '9');
+}
+
+/* Characters that never trigger expansion in an unquoted word */
+static bool is_literal_char(char c)
+{
+    return is_name_char(c) || (c != '\0' && strchr("./:@%+,=-", c) != NULL);
+}
+
+static bool at_end(const cursor_t *c)
+{
+    return c->p >= c->end;
+}
+
+static void skip_blanks(cursor_t *c)
+{
+    while (!at_end(c) && is_blank(*c->p)) {
+        c->p++;
+    }
+}
+
+static void skip_line(cursor_t *c)
+{
+    while (!at_end(c) && *c->p != '\n') {
+        c->p++;
+    }
+}
+
+/*
+ * Walk a literal assignment value made of unquoted, single-quoted and
+ * double-quoted segments. The unquoted text is written to dst when it is
+ * non-NULL. Returns false if the value needs the shell to expand it.
+ */
+static bool scan_literal(cursor_t *c, char *dst, size_t *len)
+{
+    size_t n = 0;
+
+    while (!at_end(c)) {
+        char ch = *c->p;
+
+        if (ch == '\'') {
+            c->p++;
+            while (!at_end(c) && *c->p != '\'') {
+                if (dst) {
+                    dst[n] = *c->p;
+                }
+                n++;
+                c->p++;
+            }
+            if (at_end(c)) {
+                return false;
+            }
+            c->p++;
+        } else if (ch == '"') {
+            c->p++;
+            while (!at_end(c) && *c->p != '"') {
+                if (*c->p == '$' || *c->p == '`' || *c->p == '\\') {
+                    return false;
+                }
+                if (dst) {
+                    dst[n] = *c->p;
+                }
+                n++;
+                c->p++;
+            }
+            if (at_end(c)) {
+                return false;
+            }
+            c->p++;
+        } else if (is_literal_char(ch)) {
+            if (dst) {
+                dst[n] = ch;
+            }
+            n++;
+            c->p++;
+        } else if (is_blank(ch) || ch == '\n' || ch == ';') {
+            break;
+        } else {
+            return false;
+        }
+    }
+
+    *len = n;
+    return true;
+}
+
+/* Parse an assignment value; *value is NULL for an empty literal */
+static bool parse_value(cursor_t *c, char **value)
+{
+    cursor_t start = *c;
+    size_t len = 0;
+
+    *value = NULL;
+    if (!scan_literal(c, NULL, &len)) {
+        return false;
+    }
+    if (len == 0) {
+        return true;
+    }
+
+    char *buf = malloc(len + 1);
+    if (!buf) {
+        return false;
+    }
+    scan_literal(&start, buf, &len);
+    buf[len] = '\0';
+
+    *value = buf;
+    return true;
+}
+
+/* True if c->p sits on a reserved word '{' or '}' */
+static bool at_brace_word(const cursor_t *c, char prev)
+{
+    bool boundary_before = prev == '\0' || is_blank(prev) || prev == '\n' ||
+                           prev == ';' || prev == '&' || prev == '|' ||
+                           prev == '(';
+    if (!boundary_before) {
+        return false;
+    }
+
+    const char *next = c->p + 1;
+    return next >= c->end || is_blank(*next) || *next == '\n' ||
+           *next == ';' || *next == ')' || *next == '&' || *next == '|';
+}
+
+/*
+ * Skip a function body starting at its opening brace. Quotes, comments
+ * and parameter expansions are honoured so that braces inside them do
+ * not count. Here-documents cannot be skipped reliably and are rejected.
+ */
+static bool skip_function_body(cursor_t *c)
+{
+    int depth = 0;
+    char prev = '\0';
+
+    while (!at_end(c)) {
+        char ch = *c->p;
+
+        if (ch == '\\') {
+            c->p += 2;
+            prev = 'x';
+            continue;
+        }
+
+        if (ch == '\'') {
+            c->p++;
+            while (!at_end(c) && *c->p != '\'') {
+                c->p++;
+            }
+            c->p++;
+            prev = 'x';
+            continue;
+        }
+
+        if (ch == '"') {
+            c->p++;
+            while (!at_end(c) && *c->p != '"') {
+                if (*c->p == '\\') {
+                    c->p++;
+                }
+                c->p++;
+            }
+            c->p++;
+            prev = 'x';
+            continue;
+        }
+
+        if (ch == '#' && (prev == '\0' || is_blank(prev) || prev == '\n' ||
+                          prev == ';')) {
+            skip_line(c);
+            continue;
+        }
+
+        if (ch == '$' && c->p + 1 < c->end && c->p[1] == '{') {
+            int nested = 0;
+            c->p++;
+            while (!at_end(c)) {
+                if (*c->p == '{') {
+                    nested++;
+                } else if (*c->p == '}' && --nested == 0) {
+                    break;
+                }
+                c->p++;
+            }
+            c->p++;
+            prev = 'x';
+            continue;
+        }
+
+        if (ch == '<' && c->p + 1 < c->end && c->p[1] == '<') {
+            if (c->p + 2 < c->end && c->p[2] == '<') {
+                c->p += 3;
+                prev = '<';
+                continue;
+            }
+            return false;
+        }
+
+        if (ch == '{' && at_brace_word(c, prev)) {
+            depth++;
+        } else if (ch == '}' && at_brace_word(c, prev)) {
+            if (--depth == 0) {
+                c->p++;
+                return true;
+            }
+        }
+
+        prev = ch;
+        c->p++;
+    }
+
+    return false;
+}
+
+/* Parse "name() {" / "function name {" after the name has been read */
+static bool skip_function(cursor_t *c)
+{
+    skip_blanks(c);
+    if (c->end - c->p >= 2 && c->p[0] == '(' && c->p[1] == ')') {
+        c->p += 2;
+    }
+
+    /* The opening brace may follow on a later line */
+    while (!at_end(c)) {
+        skip_blanks(c);
+        if (at_end(c) || *c->p != '\n') {
+            break;
+        }
+        c->p++;
+    }
+
+    if (at_end(c) || *c->p != '{') {
+        return false;
+    }
+
+    return skip_function_body(c);
+}
+
+static const char *read_name(cursor_t *c, size_t *len)
+{
+    const char *start = c->p;
+    while (!at_end(c) && is_name_char(*c->p)) {
+        c->p++;
+    }
+    *len = (size_t)(c->p - start);
+    return start;
+}
+
+/* Index of a tracked variable, or -1 */
+static long find_name(const char *name, size_t len,
+                      const char *const *names, size_t count)
+{
+    for (size_t i = 0; i < count; i++) {
+        if (strlen(names[i]) == len && memcmp(names[i], name, len) == 0) {
+            return (long)i;
+        }
+    }
+    return -1;
+}
+
+/* Statement terminator after an assignment or function definition */
+static bool parse_terminator(cursor_t *c)
+{
+    skip_blanks(c);
+    if (at_end(c) || *c->p == '\n' || *c->p == ';') {
+        if (!at_end(c)) {
+            c->p++;
+        }
+        return true;
+    }
+    if (*c->p == '#') {
+        skip_line(c);
+        return true;
+    }
+    return false;
+}
+
+static bool parse_script(cursor_t *c, const char *const *names, size_t count,
+                         char **values)
+{
+    while (!at_end(c)) {
+        char ch = *c->p;
+
+        if (is_blank(ch) || ch == '\n') {
+            c->p++;
+            continue;
+        }
+
+        if (ch == '#') {
+            skip_line(c);
+            continue;
+        }
+
+        if (!is_name_start(ch)) {
+            return false;
+        }
+
+        size_t len;
+        const char *name = read_name(c, &len);
+
+        if (!at_end(c) && *c->p == '=') {
+            c->p++;
+
+            char *value;
+            if (!parse_value(c, &value)) {
+                return false;
+            }
+
+            long idx = find_name(name, len, names, count);
+            if (idx >= 0) {
+                free(values[idx]);
+                values[idx] = value;
+            } else {
+                free(value);
+            }
+        } else if (len == 8 && memcmp(name, "function", 8) == 0 &&
+                   !at_end(c) && is_blank(*c->p)) {
+            skip_blanks(c);
+            if (at_end(c) || !is_name_start(*c->p)) {
+                return false;
+            }
+            read_name(c, &len);
+            if (!skip_function(c)) {
+                return false;
+            }
+        } else {
+            cursor_t look = *c;
+            skip_blanks(&look);
+            if (look.end - look.p < 2 || look.p[0] != '(' || look.p[1] != ')') {
+                return false;
+            }
+            if (!skip_function(c)) {
+                return false;
+            }
+        }
+
+        if (!parse_terminator(c)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+script_parse_result_t script_parse_vars(const char *path,
+                                        const char *const *names,
+                                        size_t count, char **values)
+{
+    for (size_t i = 0; i < count; i++) {
+        values[i] = NULL;
+    }
+
+    if (!path || !names) {
+        return SCRIPT_PARSE_ERROR;
+    }
+
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd == -1) {
+        return SCRIPT_PARSE_ERROR;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+        close(fd);
+        return SCRIPT_PARSE_ERROR;
+    }
+
+    if (st.st_size == 0) {
+        close(fd);
+        return SCRIPT_PARSE_OK;
+    }
+
+    void *map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        return SCRIPT_PARSE_ERROR;
+    }
+
+    cursor_t cursor = { map, (const char *)map + st.st_size };
+    bool ok = parse_script(&cursor, names, count, values);
+
+    munmap(map, (size_t)st.st_size);
+
+    if (!ok) {
+        for (size_t i = 0; i < count; i++) {
+            free(values[i]);
+            values[i] = NULL;
+        }
+        return SCRIPT_PARSE_DYNAMIC;
+    }
+
+    return SCRIPT_PARSE_OK;
+}
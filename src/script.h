@@ -0,0 +1,36 @@
+/*
+ * switch - alternatives management tool for NurOS
+ * Copyright (C) 2026 AnmiTaliDev <anmitali198@gmail.com>
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ */
+
+#ifndef SWITCH_SCRIPT_H
+#define SWITCH_SCRIPT_H
+
+#include <stddef.h>
+
+/* Result of a static script parse */
+typedef enum {
+    SCRIPT_PARSE_ERROR = -1,   /* Script could not be read */
+    SCRIPT_PARSE_OK = 0,       /* All values are known without running bash */
+    SCRIPT_PARSE_DYNAMIC = 1   /* Script must be evaluated by bash */
+} script_parse_result_t;
+
+/*
+ * Extract literal top-level assignments of the given variables from a
+ * module script without executing it. Values are allocated and stored in
+ * values[i] (NULL if unset or empty). Any construct that could make a
+ * value depend on execution (expansions, command substitution, commands
+ * or compound statements at top level) yields SCRIPT_PARSE_DYNAMIC and
+ * leaves every value NULL.
+ */
+script_parse_result_t script_parse_vars(const char *path,
+                                        const char *const *names,
+                                        size_t count, char **values);
+
+#endif /* SWITCH_SCRIPT_H */
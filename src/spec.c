@@ -0,0 +1,687 @@
+/*
+ * switch - alternatives management tool for NurOS
+ * Copyright (C) 2026 AnmiTaliDev <anmitali198@gmail.com>
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+#define _DEFAULT_SOURCE
+
+#include "spec.h"
+#include "arena.h"
+#include "pathid.h"
+#include "utils.h"
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <fnmatch.h>
+#include <glob.h>
+#include <limits.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#define DEFAULT_PRIORITY 10
+#define DEFAULT_NAME "{base}"
+
+/* Keys accepted in [module] */
+static const char *const module_keys[] = {
+    "name", "description", "category", "link", "extra_links", "watch",
+    "extra_targets",
+};
+
+/* One [alternatives] section */
+typedef struct {
+    const char **paths;     /* Literal paths or glob patterns, in order */
+    size_t path_count;
+    const char **excludes;  /* Name patterns to drop */
+    size_t exclude_count;
+    const char *name;       /* Name template */
+    const char *version;    /* Version template, NULL if none */
+    int priority;
+    bool symlinks;          /* Accept candidates that are symlinks */
+} spec_group_t;
+
+/* Entry of [priorities]: names matching pattern get priority */
+typedef struct {
+    const char *pattern;
+    int priority;
+} spec_priority_t;
+
+typedef struct {
+    const char *key;
+    const char *value;
+} spec_pair_t;
+
+typedef struct {
+    arena_t arena;          /* Every string below */
+    spec_pair_t *module;
+    size_t module_count;
+    spec_group_t *groups;
+    size_t group_count;
+    spec_priority_t *priorities;
+    size_t priority_count;
+} spec_t;
+
+typedef enum {
+    SECTION_NONE,
+    SECTION_MODULE,
+    SECTION_ALTERNATIVES,
+    SECTION_PRIORITIES
+} section_t;
+
+/* Append an element to a realloc'd array; returns it zeroed, or NULL */
+static void *array_push(void *items, size_t *count, size_t size)
+{
+    void **array = items;
+    char *grown = realloc(*array, (*count + 1) * size);
+    if (!grown) {
+        return NULL;
+    }
+    *array = grown;
+    char *item = grown + (*count)++ * size;
+    memset(item, 0, size);
+    return item;
+}
+
+static void spec_free(spec_t *spec)
+{
+    if (!spec) {
+        return;
+    }
+    for (size_t i = 0; i < spec->group_count; i++) {
+        free(spec->groups[i].paths);
+        free(spec->groups[i].excludes);
+    }
+    free(spec->groups);
+    free(spec->priorities);
+    free(spec->module);
+    arena_free(&spec->arena);
+    free(spec);
+}
+
+static char *trim(char *s)
+{
+    while (*s == ' ' || *s == '\t') {
+        s++;
+    }
+    char *end = s + strlen(s);
+    while (end > s && (end[-1] == ' ' || end[-1] == '\t' || end[-1] == '\r')) {
+        *--end = '\0';
+    }
+    return s;
+}
+
+static bool parse_int(const char *s, int *value)
+{
+    char *end;
+    errno = 0;
+    long n = strtol(s, &end, 10);
+    if (*s == '\0' || *end != '\0' || errno != 0 || n < INT_MIN || n > INT_MAX) {
+        return false;
+    }
+    *value = (int)n;
+    return true;
+}
+
+static bool parse_bool(const char *s, bool *value)
+{
+    if (strcmp(s, "yes") == 0 || strcmp(s, "true") == 0) {
+        *value = true;
+    } else if (strcmp(s, "no") == 0 || strcmp(s, "false") == 0) {
+        *value = false;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+/* Store one "key = value" line of the current section */
+static int spec_set(spec_t *spec, section_t section, const char *key, const char *value,
+                    const char *path, unsigned lineno)
+{
+    const char *copy = arena_strdup(&spec->arena, value);
+    if (!copy) {
+        return -1;
+    }
+
+    if (section == SECTION_MODULE) {
+        bool known = false;
+        for (size_t i = 0; i < sizeof(module_keys) / sizeof(module_keys[0]); i++) {
+            known = known || strcmp(key, module_keys[i]) == 0;
+        }
+        if (!known) {
+            print_error("%s:%u: unknown key '%s' in [module]", path, lineno, key);
+            return -1;
+        }
+        spec_pair_t *pair = array_push(&spec->module, &spec->module_count,
+                                       sizeof(spec_pair_t));
+        if (!pair) {
+            return -1;
+        }
+        pair->key = arena_strdup(&spec->arena, key);
+        pair->value = copy;
+        return pair->key ? 0 : -1;
+    }
+
+    if (section == SECTION_PRIORITIES) {
+        spec_priority_t *entry = array_push(&spec->priorities, &spec->priority_count,
+                                            sizeof(spec_priority_t));
+        if (!entry) {
+            return -1;
+        }
+        entry->pattern = arena_strdup(&spec->arena, key);
+        if (!parse_int(value, &entry->priority)) {
+            print_error("%s:%u: priority of '%s' is not a number", path, lineno, key);
+            return -1;
+        }
+        return entry->pattern ? 0 : -1;
+    }
+
+    spec_group_t *group = &spec->groups[spec->group_count - 1];
+    if (strcmp(key, "path") == 0) {
+        const char **slot = array_push(&group->paths, &group->path_count, sizeof(char *));
+        if (!slot) {
+            return -1;
+        }
+        *slot = copy;
+    } else if (strcmp(key, "exclude") == 0) {
+        const char **slot = array_push(&group->excludes, &group->exclude_count,
+                                       sizeof(char *));
+        if (!slot) {
+            return -1;
+        }
+        *slot = copy;
+    } else if (strcmp(key, "name") == 0) {
+        group->name = copy;
+    } else if (strcmp(key, "version") == 0) {
+        group->version = copy;
+    } else if (strcmp(key, "priority") == 0) {
+        if (!parse_int(value, &group->priority)) {
+            print_error("%s:%u: priority is not a number", path, lineno);
+            return -1;
+        }
+    } else if (strcmp(key, "symlinks") == 0) {
+        if (!parse_bool(value, &group->symlinks)) {
+            print_error("%s:%u: symlinks must be yes or no", path, lineno);
+            return -1;
+        }
+    } else {
+        print_error("%s:%u: unknown key '%s' in [alternatives]", path, lineno, key);
+        return -1;
+    }
+    return 0;
+}
+
+/* Parse a .switch file; errors are reported and yield NULL */
+static spec_t *spec_parse(const char *path)
+{
+    FILE *fp = fopen(path, "re");
+    if (!fp) {
+        print_error("Cannot read module %s: %s", path, strerror(errno));
+        return NULL;
+    }
+
+    spec_t *spec = calloc(1, sizeof(spec_t));
+    if (!spec) {
+        fclose(fp);
+        return NULL;
+    }
+
+    char *line = NULL;
+    size_t line_size = 0;
+    unsigned lineno = 0;
+    section_t section = SECTION_NONE;
+    int ret = 0;
+
+    while (ret == 0 && getline(&line, &line_size, fp) != -1) {
+        lineno++;
+        line[strcspn(line, "\n")] = '\0';
+        char *s = trim(line);
+
+        if (*s == '\0' || *s == '#' || *s == ';') {
+            continue;
+        }
+
+        if (*s == '[') {
+            if (strcmp(s, "[module]") == 0) {
+                section = SECTION_MODULE;
+            } else if (strcmp(s, "[alternatives]") == 0) {
+                /* Every [alternatives] header starts a new group */
+                spec_group_t *group = array_push(&spec->groups, &spec->group_count,
+                                                 sizeof(spec_group_t));
+                if (!group) {
+                    ret = -1;
+                    break;
+                }
+                group->name = DEFAULT_NAME;
+                group->priority = DEFAULT_PRIORITY;
+                group->symlinks = true;
+                section = SECTION_ALTERNATIVES;
+            } else if (strcmp(s, "[priorities]") == 0) {
+                section = SECTION_PRIORITIES;
+            } else {
+                print_error("%s:%u: unknown section %s", path, lineno, s);
+                ret = -1;
+            }
+            continue;
+        }
+
+        char *eq = strchr(s, '=');
+        if (!eq || section == SECTION_NONE) {
+            print_error("%s:%u: expected 'key = value' inside a section", path, lineno);
+            ret = -1;
+            break;
+        }
+        *eq = '\0';
+        char *key = trim(s);
+        char *value = trim(eq + 1);
+
+        /* Quotes keep leading and trailing blanks */
+        size_t len = strlen(value);
+        if (len >= 2 && value[0] == '"' && value[len - 1] == '"') {
+            value[len - 1] = '\0';
+            value++;
+        }
+
+        ret = spec_set(spec, section, key, value, path, lineno);
+    }
+
+    free(line);
+    fclose(fp);
+
+    if (ret != 0) {
+        spec_free(spec);
+        return NULL;
+    }
+    return spec;
+}
+
+int spec_read_metadata(const char *path, const char *const *keys, size_t count,
+                       char **values)
+{
+    for (size_t i = 0; i < count; i++) {
+        values[i] = NULL;
+    }
+
+    spec_t *spec = spec_parse(path);
+    if (!spec) {
+        return -1;
+    }
+
+    /* A key given twice keeps its last value */
+    for (size_t i = 0; i < count; i++) {
+        for (size_t j = 0; j < spec->module_count; j++) {
+            if (strcmp(spec->module[j].key, keys[i]) == 0) {
+                free(values[i]);
+                values[i] = *spec->module[j].value ? strdup(spec->module[j].value) : NULL;
+            }
+        }
+    }
+
+    spec_free(spec);
+    return 0;
+}
+
+/* Component index of a path, counting the empty one before a leading '/' */
+static bool path_component(const char *s, size_t index, const char **start, size_t *len)
+{
+    for (size_t i = 0; i < index; i++) {
+        s = strchr(s, '/');
+        if (!s) {
+            return false;
+        }
+        s++;
+    }
+    *start = s;
+    *len = strcspn(s, "/");
+    return true;
+}
+
+/*
+ * Text matched by the n-th (1-based) wildcard component of pattern. glob()
+ * never matches across '/', so components of pattern and path correspond.
+ */
+static bool capture(const char *pattern, const char *path, unsigned n,
+                    const char **start, size_t *len)
+{
+    const char *comp;
+    size_t comp_len;
+    for (size_t i = 0; path_component(pattern, i, &comp, &comp_len); i++) {
+        bool wildcard = false;
+        for (size_t k = 0; k < comp_len; k++) {
+            wildcard = wildcard || strchr("*?[", comp[k]);
+        }
+        if (wildcard && --n == 0) {
+            return path_component(path, i, start, len);
+        }
+    }
+    return false;
+}
+
+/*
+ * Expand {path}, {base}, {dir}, {name} and {1}..{9} in tmpl. Unknown
+ * placeholders are copied unchanged. Returns NULL on allocation failure.
+ */
+static char *expand(const char *tmpl, const char *path, const char *pattern,
+                    const char *name)
+{
+    char *out = NULL;
+    size_t out_size = 0;
+    FILE *fp = open_memstream(&out, &out_size);
+    if (!fp) {
+        return NULL;
+    }
+
+    const char *base = strrchr(path, '/');
+    base = base ? base + 1 : path;
+    size_t dir_len = base > path + 1 ? (size_t)(base - path - 1) : (base > path ? 1 : 0);
+
+    for (const char *p = tmpl; *p; p++) {
+        const char *close = *p == '{' ? strchr(p, '}') : NULL;
+        if (!close) {
+            fputc(*p, fp);
+            continue;
+        }
+
+        size_t len = (size_t)(close - p - 1);
+        const char *key = p + 1;
+        const char *start;
+        size_t start_len;
+
+        if (len == 4 && strncmp(key, "path", 4) == 0) {
+            fputs(path, fp);
+        } else if (len == 4 && strncmp(key, "base", 4) == 0) {
+            fputs(base, fp);
+        } else if (len == 3 && strncmp(key, "dir", 3) == 0) {
+            fwrite(path, 1, dir_len, fp);
+        } else if (len == 4 && strncmp(key, "name", 4) == 0 && name) {
+            fputs(name, fp);
+        } else if (len == 1 && *key >= '1' && *key <= '9' && pattern &&
+                   capture(pattern, path, (unsigned)(*key - '0'), &start, &start_len)) {
+            fwrite(start, 1, start_len, fp);
+        } else {
+            fwrite(p, 1, len + 2, fp);
+        }
+        p = close;
+    }
+
+    if (fclose(fp) != 0) {
+        free(out);
+        return NULL;
+    }
+    return out;
+}
+
+/* Write s as a record field, escaping '|', newlines and backslashes */
+static void write_field(FILE *fp, const char *s)
+{
+    for (; *s; s++) {
+        if (*s == '|' || *s == '\\') {
+            fputc('\\', fp);
+            fputc(*s, fp);
+        } else if (*s == '\n') {
+            fputs("\\n", fp);
+        } else {
+            fputc(*s, fp);
+        }
+    }
+}
+
+/* Candidate path with the group and pattern it came from */
+typedef struct {
+    char *path;
+    const spec_group_t *group;
+    const char *pattern;    /* Glob it matched, NULL for a literal path */
+} candidate_t;
+
+static int add_candidate(candidate_t **items, size_t *count, const char *path,
+                         const spec_group_t *group, const char *pattern)
+{
+    candidate_t *item = array_push(items, count, sizeof(candidate_t));
+    if (!item) {
+        return -1;
+    }
+    item->path = strdup(path);
+    item->group = group;
+    item->pattern = pattern;
+    return item->path ? 0 : -1;
+}
+
+/*
+ * glob() pattern inside the root: the root, escaped, is matched as a
+ * literal prefix and stripped again from every match.
+ */
+static int glob_in_root(const char *pattern, glob_t *matches)
+{
+    const char *root = root_dir();
+    if (!*root) {
+        return glob(pattern, 0, NULL, matches);
+    }
+
+    size_t root_len = strlen(root);
+    char *full = malloc(2 * root_len + strlen(pattern) + 1);
+    if (!full) {
+        return GLOB_NOSPACE;
+    }
+    char *q = full;
+    for (const char *p = root; *p; p++) {
+        if (strchr("*?[\\", *p)) {
+            *q++ = '\\';
+        }
+        *q++ = *p;
+    }
+    strcpy(q, pattern);
+
+    int ret = glob(full, 0, NULL, matches);
+    free(full);
+    for (size_t m = 0; ret == 0 && m < matches->gl_pathc; m++) {
+        char *path = matches->gl_pathv[m];
+        memmove(path, path + root_len, strlen(path + root_len) + 1);
+    }
+    return ret;
+}
+
+/* Expand every path of every group, in order; globs are sorted */
+static int collect_candidates(const spec_t *spec, candidate_t **items, size_t *count)
+{
+    for (size_t g = 0; g < spec->group_count; g++) {
+        const spec_group_t *group = &spec->groups[g];
+        for (size_t i = 0; i < group->path_count; i++) {
+            const char *pattern = group->paths[i];
+            if (!strpbrk(pattern, "*?[")) {
+                if (add_candidate(items, count, pattern, group, NULL) != 0) {
+                    return -1;
+                }
+                continue;
+            }
+
+            glob_t matches;
+            int ret = glob_in_root(pattern, &matches);
+            if (ret == GLOB_NOMATCH) {
+                continue;
+            }
+            if (ret != 0) {
+                return -1;
+            }
+            for (size_t m = 0; m < matches.gl_pathc; m++) {
+                if (add_candidate(items, count, matches.gl_pathv[m], group, pattern) != 0) {
+                    globfree(&matches);
+                    return -1;
+                }
+            }
+            globfree(&matches);
+        }
+    }
+    return 0;
+}
+
+static int priority_for(const spec_t *spec, const spec_group_t *group, const char *name)
+{
+    for (size_t i = 0; i < spec->priority_count; i++) {
+        if (fnmatch(spec->priorities[i].pattern, name, 0) == 0) {
+            return spec->priorities[i].priority;
+        }
+    }
+    return group->priority;
+}
+
+static bool excluded(const spec_group_t *group, const char *name)
+{
+    for (size_t i = 0; i < group->exclude_count; i++) {
+        if (fnmatch(group->excludes[i], name, 0) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+char *spec_find_alternatives(const char *path)
+{
+    spec_t *spec = spec_parse(path);
+    if (!spec) {
+        return NULL;
+    }
+
+    candidate_t *candidates = NULL;
+    size_t count = 0;
+    bool *usable = NULL;
+    char *out = NULL;
+    size_t out_size = 0;
+    FILE *fp = NULL;
+
+    int ret = collect_candidates(spec, &candidates, &count);
+
+    /*
+     * Candidates are checked one by one, all before any is formatted. The
+     * io_uring statx batch of scan.c does not fit here: under --root every
+     * check must resolve inside the image (openat2 RESOLVE_IN_ROOT), which
+     * a statx request cannot do, and a module matches a few dozen files at
+     * most, far below SCAN_URING_MIN where setting up a ring pays off.
+     */
+    if (ret == 0 && count > 0) {
+        usable = calloc(count, sizeof(bool));
+        ret = usable ? 0 : -1;
+    }
+    for (size_t i = 0; ret == 0 && i < count; i++) {
+        usable[i] = path_executable(candidates[i].path);
+        if (usable[i] && !candidates[i].group->symlinks) {
+            struct stat st;
+            usable[i] = path_stat(candidates[i].path, &st, false) == 0 &&
+                        !S_ISLNK(st.st_mode);
+        }
+    }
+
+    if (ret == 0) {
+        fp = open_memstream(&out, &out_size);
+        ret = fp ? 0 : -1;
+    }
+
+    for (size_t i = 0; ret == 0 && i < count; i++) {
+        if (!usable[i]) {
+            continue;
+        }
+
+        const candidate_t *c = &candidates[i];
+        char *name = expand(c->group->name, c->path, c->pattern, NULL);
+        if (!name) {
+            ret = -1;
+            break;
+        }
+        char *version = NULL;
+        if (c->group->version &&
+            !(version = expand(c->group->version, c->path, c->pattern, name))) {
+            free(name);
+            ret = -1;
+            break;
+        }
+        if (*name && !excluded(c->group, name)) {
+            write_field(fp, c->path);
+            fputc('|', fp);
+            write_field(fp, name);
+            fprintf(fp, "|%d", priority_for(spec, c->group, name));
+            if (version && *version) {
+                fputc('|', fp);
+                write_field(fp, version);
+            }
+            fputc('\n', fp);
+        }
+        free(version);
+        free(name);
+    }
+
+    if (fp && fclose(fp) != 0) {
+        ret = -1;
+    }
+    if (ret != 0) {
+        print_error("Failed to evaluate module %s", path);
+        free(out);
+        out = NULL;
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        free(candidates[i].path);
+    }
+    free(candidates);
+    free(usable);
+    spec_free(spec);
+    return out;
+}
+
+char *spec_extra_targets(const char *path, const char *alt_path, const char *alt_name)
+{
+    spec_t *spec = spec_parse(path);
+    if (!spec) {
+        return NULL;
+    }
+
+    const char *templates = NULL;
+    for (size_t i = 0; i < spec->module_count; i++) {
+        if (strcmp(spec->module[i].key, "extra_targets") == 0) {
+            templates = spec->module[i].value;
+        }
+    }
+
+    char *out = NULL;
+    size_t out_size = 0;
+    FILE *fp = open_memstream(&out, &out_size);
+    char *list = templates ? strdup(templates) : NULL;
+    int ret = fp && (!templates || list) ? 0 : -1;
+
+    /* Empty entries are kept, so templates line up with extra_links */
+    char *next = list;
+    while (ret == 0 && next) {
+        char *tmpl = strsep(&next, ":");
+        char *target = *tmpl ? expand(tmpl, alt_path, NULL, alt_name) : strdup("");
+        if (!target) {
+            ret = -1;
+            break;
+        }
+
+        struct stat st;
+        if (*target && path_stat(target, &st, false) == 0) {
+            fputs(target, fp);
+        }
+        fputc('\n', fp);
+        free(target);
+    }
+
+    if (fp && fclose(fp) != 0) {
+        ret = -1;
+    }
+    if (ret != 0) {
+        free(out);
+        out = NULL;
+    }
+
+    free(list);
+    spec_free(spec);
+    return out;
+}
@@ -0,0 +1,45 @@
+/*
+ * switch - alternatives management tool for NurOS
+ * Copyright (C) 2026 AnmiTaliDev <anmitali198@gmail.com>
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ */
+
+#ifndef SWITCH_SPEC_H
+#define SWITCH_SPEC_H
+
+#include <stddef.h>
+
+/*
+ * Declarative modules: ".switch" files with a [module] section holding the
+ * metadata, [alternatives] sections listing candidate paths or globs and an
+ * optional [priorities] table, evaluated without starting a shell. See
+ * docs/modules.md for the format.
+ */
+
+/*
+ * Read the [module] keys named in keys into values (allocated, NULL when
+ * unset). Returns -1, with every value NULL, if the file cannot be read or
+ * is malformed.
+ */
+int spec_read_metadata(const char *path, const char *const *keys, size_t count,
+                       char **values);
+
+/*
+ * Evaluate the [alternatives] sections. Returns the result in
+ * find_alternatives format (caller frees), or NULL on error.
+ */
+char *spec_find_alternatives(const char *path);
+
+/*
+ * Expand the extra_targets templates for an alternative, one line per
+ * template like extra_link_targets(); targets that do not exist are left
+ * empty. Returns "" when none are declared, NULL on error.
+ */
+char *spec_extra_targets(const char *path, const char *alt_path, const char *alt_name);
+
+#endif /* SWITCH_SPEC_H */
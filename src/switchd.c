@@ -0,0 +1,657 @@
+/*
+ * switchd - resident module cache for switch
+ * Copyright (C) 2026 AnmiTaliDev <anmitali198@gmail.com>
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * switchd keeps the scanned modules, their metadata and their alternatives
+ * in memory and answers evaluation requests on a Unix socket using the
+ * module host protocol: a request is "<script>\n<flag>\n" and the reply is
+ * the evaluation record wrapped in a netstring, empty for scripts the
+ * daemon does not know. Entries are dropped through inotify when a module
+ * directory or a module's MODULE_WATCH paths change; a lost event queue
+ * rescans everything, and a watched path that goes away is watched again
+ * if it can be, or stops its modules from being memoized.
+ *
+ * Requests are served one at a time on a single thread: while a module
+ * that is not memoized is evaluated, other clients wait. Their own time
+ * limit (--timeout) lets them give up and evaluate locally.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+#define _DEFAULT_SOURCE
+
+#include "config.h"
+#include "module.h"
+#include "utils.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <poll.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/inotify.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/un.h>
+
+#define MAX_CLIENTS 64
+#define MAX_REQUEST 8192
+#define CLIENT_SEND_TIMEOUT_SEC 5
+
+#define WATCH_EVENTS (IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | \
+                      IN_CLOSE_WRITE | IN_ATTRIB | IN_DELETE_SELF | IN_MOVE_SELF)
+
+/* inotify watch on a module directory or a MODULE_WATCH path */
+typedef struct {
+    int wd;
+    char *path;
+    bool module_dir;
+} watch_t;
+
+/* Connected client and its pending request bytes */
+typedef struct {
+    int fd;
+    char buf[MAX_REQUEST];
+    size_t size;
+} client_t;
+
+typedef struct {
+    switch_config_t config;
+    module_list_t modules;
+    char **alternatives;    /* Memoized find_alternatives output per module */
+    bool *memoizable;       /* Every watched path of the module is watched */
+    int inotify_fd;
+    watch_t *watches;
+    size_t watch_count;
+    size_t watch_capacity;
+    int listen_fd;
+    client_t *clients[MAX_CLIENTS];
+    size_t client_count;
+} daemon_state_t;
+
+static volatile sig_atomic_t g_stop = 0;
+
+static void handle_signal(int sig)
+{
+    (void)sig;
+    g_stop = 1;
+}
+
+static void print_usage(const char *progname)
+{
+    printf("Usage: %s [OPTIONS]\n", progname);
+    printf("\n");
+    printf("Resident module cache for switch.\n");
+    printf("\n");
+    printf("Options:\n");
+    printf("  -s, --socket=PATH     Listen on PATH (default: $XDG_RUNTIME_DIR/%s)\n",
+           SWITCH_SOCKET_NAME);
+    printf("  -h, --help            Show this help message\n");
+    printf("  -V, --version         Show version information\n");
+}
+
+/* Watch path; returns false if it cannot be watched */
+static bool daemon_add_watch(daemon_state_t *state, const char *path, bool module_dir)
+{
+    for (size_t i = 0; i < state->watch_count; i++) {
+        if (strcmp(state->watches[i].path, path) == 0) {
+            state->watches[i].module_dir |= module_dir;
+            return true;
+        }
+    }
+
+    int wd = inotify_add_watch(state->inotify_fd, path, WATCH_EVENTS);
+    if (wd == -1) {
+        return false;
+    }
+
+    if (state->watch_count >= state->watch_capacity) {
+        size_t new_capacity = state->watch_capacity ? state->watch_capacity * 2 : 16;
+        watch_t *new_watches = realloc(state->watches, new_capacity * sizeof(watch_t));
+        if (!new_watches) {
+            inotify_rm_watch(state->inotify_fd, wd);
+            return false;
+        }
+        state->watches = new_watches;
+        state->watch_capacity = new_capacity;
+    }
+
+    char *copy = strdup(path);
+    if (!copy) {
+        inotify_rm_watch(state->inotify_fd, wd);
+        return false;
+    }
+
+    state->watches[state->watch_count++] = (watch_t){ wd, copy, module_dir };
+    return true;
+}
+
+/* Watch every MODULE_WATCH path; alternatives are memoized only if all are */
+static bool daemon_watch_module(daemon_state_t *state, const module_info_t *module)
+{
+    if (!module->watch || !*module->watch) {
+        return false;
+    }
+
+    char *paths = strdup(module->watch);
+    if (!paths) {
+        return false;
+    }
+
+    bool all = true;
+    char *saveptr = NULL;
+    for (char *dir = strtok_r(paths, ":", &saveptr); dir;
+         dir = strtok_r(NULL, ":", &saveptr)) {
+        all &= daemon_add_watch(state, dir, false);
+    }
+
+    free(paths);
+    return all;
+}
+
+static int daemon_load(daemon_state_t *state)
+{
+    if (module_list_init(&state->modules) != 0 ||
+        module_scan(&state->modules, &state->config) != 0) {
+        return -1;
+    }
+
+    module_cache_init(&state->config);
+    module_load_all(&state->modules, state->config.jobs);
+
+    size_t count = state->modules.count;
+    state->alternatives = calloc(count + 1, sizeof(char *));
+    state->memoizable = calloc(count + 1, sizeof(bool));
+    if (!state->alternatives || !state->memoizable) {
+        return -1;
+    }
+
+    if (state->config.user_modules_dir) {
+        daemon_add_watch(state, state->config.user_modules_dir, true);
+    }
+    if (state->config.system_modules_dir) {
+        daemon_add_watch(state, state->config.system_modules_dir, true);
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        state->memoizable[i] = daemon_watch_module(state, &state->modules.modules[i]);
+    }
+
+    return 0;
+}
+
+static void daemon_unload(daemon_state_t *state)
+{
+    for (size_t i = 0; state->alternatives && i < state->modules.count; i++) {
+        free(state->alternatives[i]);
+    }
+    free(state->alternatives);
+    free(state->memoizable);
+    state->alternatives = NULL;
+    state->memoizable = NULL;
+
+    module_cache_finish();
+    module_list_free(&state->modules);
+
+    for (size_t i = 0; i < state->watch_count; i++) {
+        inotify_rm_watch(state->inotify_fd, state->watches[i].wd);
+        free(state->watches[i].path);
+    }
+    state->watch_count = 0;
+}
+
+static void daemon_reload(daemon_state_t *state)
+{
+    daemon_unload(state);
+    if (daemon_load(state) != 0) {
+        print_error("Failed to rescan modules");
+    }
+}
+
+/* Check whether path is one of the module's MODULE_WATCH entries */
+static bool module_watches(const module_info_t *module, const char *path)
+{
+    if (!module->watch) {
+        return false;
+    }
+
+    size_t len = strlen(path);
+    for (const char *p = module->watch; p; p = strchr(p, ':')) {
+        if (*p == ':') {
+            p++;
+        }
+        if (strncmp(p, path, len) == 0 && (p[len] == ':' || p[len] == '\0')) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/* Drop memoized alternatives of every module watching path */
+static void daemon_invalidate(daemon_state_t *state, const char *path)
+{
+    for (size_t i = 0; i < state->modules.count; i++) {
+        if (state->alternatives[i] &&
+            module_watches(&state->modules.modules[i], path)) {
+            free(state->alternatives[i]);
+            state->alternatives[i] = NULL;
+        }
+    }
+}
+
+/*
+ * Replace the watch at index, whose path was deleted, moved away or
+ * unmounted. If nothing can be watched at the path any more, the modules
+ * watching it are no longer memoized until the next reload.
+ */
+static void daemon_rewatch(daemon_state_t *state, size_t index, uint32_t mask)
+{
+    watch_t dead = state->watches[index];
+    if (!(mask & IN_IGNORED)) {
+        inotify_rm_watch(state->inotify_fd, dead.wd);
+    }
+    state->watches[index] = state->watches[--state->watch_count];
+
+    /* A rename over the path leaves something to watch right away */
+    if (!daemon_add_watch(state, dead.path, false)) {
+        for (size_t i = 0; i < state->modules.count; i++) {
+            if (module_watches(&state->modules.modules[i], dead.path)) {
+                state->memoizable[i] = false;
+            }
+        }
+    }
+    free(dead.path);
+}
+
+static void daemon_handle_inotify(daemon_state_t *state)
+{
+    char buf[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+    bool reload = false;
+
+    for (;;) {
+        ssize_t len = read(state->inotify_fd, buf, sizeof(buf));
+        if (len <= 0) {
+            break;
+        }
+
+        for (char *p = buf; p < buf + len;) {
+            const struct inotify_event *event = (const struct inotify_event *)p;
+            p += sizeof(struct inotify_event) + event->len;
+
+            /* Events were lost: start over with fresh watches */
+            if (event->mask & IN_Q_OVERFLOW) {
+                reload = true;
+                continue;
+            }
+
+            for (size_t i = 0; i < state->watch_count; i++) {
+                if (state->watches[i].wd != event->wd) {
+                    continue;
+                }
+                if (state->watches[i].module_dir) {
+                    reload = true;
+                }
+                daemon_invalidate(state, state->watches[i].path);
+                if (!state->watches[i].module_dir &&
+                    (event->mask & (IN_DELETE_SELF | IN_MOVE_SELF | IN_IGNORED))) {
+                    daemon_rewatch(state, i, event->mask);
+                }
+                break;
+            }
+        }
+    }
+
+    if (reload) {
+        daemon_reload(state);
+    }
+}
+
+static int send_all(int fd, const char *data, size_t size)
+{
+    while (size > 0) {
+        ssize_t n = send(fd, data, size, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -1;
+        }
+        data += n;
+        size -= (size_t)n;
+    }
+    return 0;
+}
+
+static int daemon_reply(int fd, const char *record, size_t size)
+{
+    char header[32];
+    int len = snprintf(header, sizeof(header), "%zu:", size);
+    if (send_all(fd, header, (size_t)len) != 0 ||
+        send_all(fd, record, size) != 0 ||
+        send_all(fd, ",", 1) != 0) {
+        return -1;
+    }
+    return 0;
+}
+
+static int daemon_answer(daemon_state_t *state, int fd, const char *path, bool with_alts)
+{
+    module_info_t *module = NULL;
+    size_t index = 0;
+    for (size_t i = 0; i < state->modules.count; i++) {
+        if (strcmp(state->modules.modules[i].path, path) == 0) {
+            module = &state->modules.modules[i];
+            index = i;
+            break;
+        }
+    }
+
+    if (!module) {
+        return daemon_reply(fd, "", 0);
+    }
+
+    char *raw = NULL;
+    if (with_alts) {
+        if (state->alternatives[index]) {
+            raw = state->alternatives[index];
+        } else if (module_load_raw(module, &raw) != 0) {
+            return daemon_reply(fd, "", 0);
+        } else if (state->memoizable[index] && raw) {
+            state->alternatives[index] = raw;
+        }
+    } else {
+        module_load_metadata(module);
+    }
+
+    size_t size = 0;
+    char *record = module_format_record(module, raw, &size);
+    if (raw && raw != state->alternatives[index]) {
+        free(raw);
+    }
+    if (!record) {
+        return daemon_reply(fd, "", 0);
+    }
+
+    int ret = daemon_reply(fd, record, size);
+    free(record);
+    return ret;
+}
+
+/* Serve every complete request in the client's buffer */
+static int daemon_serve(daemon_state_t *state, client_t *client)
+{
+    for (;;) {
+        char *path_end = memchr(client->buf, '\n', client->size);
+        if (!path_end) {
+            break;
+        }
+        char *flag_end = memchr(path_end + 1, '\n',
+                                client->size - (size_t)(path_end + 1 - client->buf));
+        if (!flag_end) {
+            break;
+        }
+
+        *path_end = '\0';
+        *flag_end = '\0';
+        bool with_alts = path_end[1] != '\0';
+
+        if (daemon_answer(state, client->fd, client->buf, with_alts) != 0) {
+            return -1;
+        }
+
+        size_t consumed = (size_t)(flag_end + 1 - client->buf);
+        memmove(client->buf, flag_end + 1, client->size - consumed);
+        client->size -= consumed;
+    }
+
+    /* A request that fills the buffer without a newline is not valid */
+    return client->size < sizeof(client->buf) ? 0 : -1;
+}
+
+static void daemon_accept(daemon_state_t *state)
+{
+    int fd = accept(state->listen_fd, NULL, NULL);
+    if (fd == -1) {
+        return;
+    }
+    fcntl(fd, F_SETFD, FD_CLOEXEC);
+
+    if (state->client_count >= MAX_CLIENTS) {
+        close(fd);
+        return;
+    }
+
+    /* A client that stops reading must not stall the daemon forever */
+    struct timeval timeout = { .tv_sec = CLIENT_SEND_TIMEOUT_SEC };
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+
+    client_t *client = calloc(1, sizeof(client_t));
+    if (!client) {
+        close(fd);
+        return;
+    }
+    client->fd = fd;
+    state->clients[state->client_count++] = client;
+}
+
+static void daemon_drop_client(daemon_state_t *state, size_t index)
+{
+    close(state->clients[index]->fd);
+    free(state->clients[index]);
+    state->clients[index] = state->clients[--state->client_count];
+}
+
+static int daemon_listen(const char *path)
+{
+    struct sockaddr_un addr = { .sun_family = AF_UNIX };
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        print_error("Socket path too long: %s", path);
+        return -1;
+    }
+    strcpy(addr.sun_path, path);
+
+    char *dir = strdup(path);
+    if (!dir) {
+        return -1;
+    }
+    char *slash = strrchr(dir, '/');
+    if (slash && slash != dir) {
+        *slash = '\0';
+        make_dirs(dir, 0700);
+    }
+    free(dir);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd == -1) {
+        return -1;
+    }
+
+    /* Refuse to replace a daemon that is still answering */
+    if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) == 0) {
+        print_error("switchd is already running on %s", path);
+        close(fd);
+        return -1;
+    }
+    unlink(path);
+
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 ||
+        chmod(path, 0600) != 0 || listen(fd, 16) != 0) {
+        print_error("Failed to listen on %s: %s", path, strerror(errno));
+        close(fd);
+        return -1;
+    }
+
+    return fd;
+}
+
+static int daemon_run(daemon_state_t *state)
+{
+    struct pollfd pfds[MAX_CLIENTS + 2];
+
+    while (!g_stop) {
+        pfds[0] = (struct pollfd){ .fd = state->listen_fd, .events = POLLIN };
+        pfds[1] = (struct pollfd){ .fd = state->inotify_fd, .events = POLLIN };
+        for (size_t i = 0; i < state->client_count; i++) {
+            pfds[i + 2] = (struct pollfd){ .fd = state->clients[i]->fd, .events = POLLIN };
+        }
+
+        size_t nfds = state->client_count + 2;
+        if (poll(pfds, nfds, -1) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -1;
+        }
+
+        if (pfds[1].revents) {
+            daemon_handle_inotify(state);
+        }
+
+        /* Walk backwards so dropping a client keeps earlier indices valid */
+        for (size_t i = nfds - 2; i-- > 0;) {
+            if (!pfds[i + 2].revents) {
+                continue;
+            }
+
+            client_t *client = state->clients[i];
+            ssize_t n = read(client->fd, client->buf + client->size,
+                             sizeof(client->buf) - client->size);
+            if (n <= 0 && !(n < 0 && errno == EINTR)) {
+                daemon_drop_client(state, i);
+                continue;
+            }
+            if (n > 0) {
+                client->size += (size_t)n;
+                if (daemon_serve(state, client) != 0) {
+                    daemon_drop_client(state, i);
+                }
+            }
+        }
+
+        if (pfds[0].revents) {
+            daemon_accept(state);
+        }
+    }
+
+    return 0;
+}
+
+static struct option long_options[] = {
+    {"socket",  required_argument, NULL, 's'},
+    {"help",    no_argument,       NULL, 'h'},
+    {"version", no_argument,       NULL, 'V'},
+    {NULL,      0,                 NULL, 0}
+};
+
+int main(int argc, char *argv[])
+{
+    const char *socket_path = NULL;
+    int opt;
+
+    while ((opt = getopt_long(argc, argv, "s:hV", long_options, NULL)) != -1) {
+        switch (opt) {
+        case 's':
+            socket_path = optarg;
+            break;
+        case 'h':
+            print_usage(argv[0]);
+            return 0;
+        case 'V':
+            printf("switchd %s\n", SWITCH_VERSION);
+            return 0;
+        default:
+            fprintf(stderr, "Try '%s --help' for more information.\n", argv[0]);
+            return 1;
+        }
+    }
+
+    color_init();
+
+    /* switchd serves the running system, never an image tree */
+    unsetenv("SWITCH_ROOT");
+
+    /* Modules evaluated here call the client next to this binary */
+    char *self = self_path(argv[0]);
+    if (self && !getenv("SWITCH_BIN")) {
+        char *slash = strrchr(self, '/');
+        size_t len = (size_t)(slash - self) + sizeof("/switch");
+        char *client = malloc(len);
+        if (client) {
+            snprintf(client, len, "%.*s/switch", (int)(slash - self), self);
+            if (is_executable(client)) {
+                setenv("SWITCH_BIN", client, 1);
+            }
+            free(client);
+        }
+    }
+    free(self);
+
+    daemon_state_t state;
+    memset(&state, 0, sizeof(state));
+    state.listen_fd = -1;
+
+    if (config_init(&state.config) != 0) {
+        print_error("Failed to initialize configuration");
+        return 1;
+    }
+
+    if (socket_path) {
+        free(state.config.socket_path);
+        state.config.socket_path = strdup(socket_path);
+    }
+    if (!state.config.socket_path) {
+        print_error("No socket path: set XDG_RUNTIME_DIR or use --socket");
+        config_free(&state.config);
+        return 1;
+    }
+
+    struct sigaction sa = { .sa_handler = handle_signal };
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGTERM, &sa, NULL);
+    sigaction(SIGINT, &sa, NULL);
+    signal(SIGPIPE, SIG_IGN);
+
+    int ret = 1;
+    state.inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (state.inotify_fd == -1) {
+        print_error("inotify unavailable: %s", strerror(errno));
+        goto out;
+    }
+
+    state.listen_fd = daemon_listen(state.config.socket_path);
+    if (state.listen_fd == -1) {
+        goto out;
+    }
+
+    if (daemon_load(&state) != 0) {
+        print_error("Failed to scan modules");
+        goto out;
+    }
+
+    ret = daemon_run(&state) == 0 ? 0 : 1;
+
+out:
+    while (state.client_count > 0) {
+        daemon_drop_client(&state, state.client_count - 1);
+    }
+    daemon_unload(&state);
+    free(state.watches);
+    if (state.listen_fd != -1) {
+        close(state.listen_fd);
+        unlink(state.config.socket_path);
+    }
+    if (state.inotify_fd != -1) {
+        close(state.inotify_fd);
+    }
+    config_free(&state.config);
+    return ret;
+}
@@ -0,0 +1,145 @@
+/*
+ * switch - alternatives management tool for NurOS
+ * Copyright (C) 2026 AnmiTaliDev <anmitali198@gmail.com>
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+#define _DEFAULT_SOURCE
+
+#include "trace.h"
+#include <stdio.h>
+#include <stdio_ext.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+bool g_trace_enabled = false;
+
+static FILE *g_trace_file = NULL;
+static uint64_t g_trace_origin = 0;
+static pid_t g_trace_pid = 0;
+
+uint64_t trace_now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+/* Write s as the body of a JSON string */
+static void write_escaped(const char *s)
+{
+    for (; *s; s++) {
+        unsigned char c = (unsigned char)*s;
+        if (c == '"' || c == '\\') {
+            fprintf(g_trace_file, "\\%c", c);
+        } else if (c < 0x20) {
+            fprintf(g_trace_file, "\\u%04x", c);
+        } else {
+            fputc(c, g_trace_file);
+        }
+    }
+}
+
+/* Common part of a complete ("X") event; timestamps are in microseconds */
+static void write_event_head(const char *name, uint64_t start, long tid)
+{
+    uint64_t end = trace_now();
+    if (start < g_trace_origin) {
+        start = g_trace_origin;
+    }
+
+    fputs(",\n{\"name\":\"", g_trace_file);
+    write_escaped(name);
+    fprintf(g_trace_file,
+            "\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":%ld,\"tid\":%ld,\"args\":{",
+            (double)(start - g_trace_origin) / 1000.0,
+            (double)(end - start) / 1000.0,
+            (long)g_trace_pid, tid);
+}
+
+int trace_open(const char *path)
+{
+    if (!path || !*path) {
+        return -1;
+    }
+
+    g_trace_file = fopen(path, "we");
+    if (!g_trace_file) {
+        return -1;
+    }
+
+    g_trace_origin = trace_now();
+    g_trace_pid = getpid();
+    g_trace_enabled = true;
+
+    fprintf(g_trace_file,
+            "[{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%ld,\"args\":{\"name\":\"switch\"}}",
+            (long)g_trace_pid);
+    return 0;
+}
+
+void trace_close(void)
+{
+    if (!g_trace_file) {
+        return;
+    }
+
+    fputs("\n]\n", g_trace_file);
+    fclose(g_trace_file);
+    g_trace_file = NULL;
+    g_trace_enabled = false;
+}
+
+void trace_detach(void)
+{
+    if (!g_trace_file) {
+        return;
+    }
+
+    /* Events buffered before fork() belong to the parent */
+    __fpurge(g_trace_file);
+    fclose(g_trace_file);
+    g_trace_file = NULL;
+    g_trace_enabled = false;
+}
+
+void trace_span_write(const char *name, uint64_t start, const char *key,
+                      const char *value)
+{
+    write_event_head(name, start, (long)g_trace_pid);
+    if (key && value) {
+        fputc('"', g_trace_file);
+        write_escaped(key);
+        fputs("\":\"", g_trace_file);
+        write_escaped(value);
+        fputc('"', g_trace_file);
+    }
+    fputs("}}", g_trace_file);
+}
+
+void trace_child_write(const char *name, uint64_t start, const char *module,
+                       pid_t pid, size_t bytes, int status)
+{
+    write_event_head(name, start, (long)pid);
+    fprintf(g_trace_file, "\"pid\":%ld,\"bytes\":%zu", (long)pid, bytes);
+    if (module) {
+        fputs(",\"module\":\"", g_trace_file);
+        write_escaped(module);
+        fputc('"', g_trace_file);
+    }
+    if (status != -1) {
+        if (WIFEXITED(status)) {
+            fprintf(g_trace_file, ",\"exit_status\":%d", WEXITSTATUS(status));
+        } else if (WIFSIGNALED(status)) {
+            fprintf(g_trace_file, ",\"signal\":%d", WTERMSIG(status));
+        }
+    }
+    fputs("}}", g_trace_file);
+}
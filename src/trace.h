@@ -0,0 +1,70 @@
+/*
+ * switch - alternatives management tool for NurOS
+ * Copyright (C) 2026 AnmiTaliDev <anmitali198@gmail.com>
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ */
+
+#ifndef SWITCH_TRACE_H
+#define SWITCH_TRACE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+/* True while a trace file is open; checked inline so disabled spans cost a branch */
+extern bool g_trace_enabled;
+
+/*
+ * Start writing Chrome trace events (JSON array format, loadable in
+ * chrome://tracing and Perfetto) to path. Returns 0 on success.
+ */
+int trace_open(const char *path);
+
+/* Finish the trace file */
+void trace_close(void);
+
+/* Stop tracing in a forked child, leaving the parent's file untouched */
+void trace_detach(void);
+
+/* Monotonic time in nanoseconds */
+uint64_t trace_now(void);
+
+void trace_span_write(const char *name, uint64_t start, const char *key,
+                      const char *value);
+void trace_child_write(const char *name, uint64_t start, const char *module,
+                       pid_t pid, size_t bytes, int status);
+
+/* Start time of a span, 0 when tracing is disabled */
+static inline uint64_t trace_begin(void)
+{
+    return g_trace_enabled ? trace_now() : 0;
+}
+
+/* Record a span from start until now, with an optional string argument */
+static inline void trace_span(const char *name, uint64_t start, const char *key,
+                              const char *value)
+{
+    if (g_trace_enabled) {
+        trace_span_write(name, start, key, value);
+    }
+}
+
+/*
+ * Record a child process from start until now on its own track, with the
+ * module it served, bytes read from it and its wait status (-1 if unknown).
+ */
+static inline void trace_child(const char *name, uint64_t start, const char *module,
+                               pid_t pid, size_t bytes, int status)
+{
+    if (g_trace_enabled) {
+        trace_child_write(name, start, module, pid, bytes, status);
+    }
+}
+
+#endif /* SWITCH_TRACE_H */
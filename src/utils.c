@@ -9,15 +9,20 @@
  * (at your option) any later version.
  */
 
+#define _POSIX_C_SOURCE 200809L
+#define _DEFAULT_SOURCE
+
 #include "utils.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdarg.h>
 #include <string.h>
+#include <errno.h>
 #include <unistd.h>
 #include <sys/stat.h>
 
 static bool g_color_enabled = false;
+static char *g_root_dir = NULL;
 
 /* ANSI color codes */
 static const char *color_codes[] = {
@@ -216,3 +221,73 @@ bool is_executable(const char *path)
 
     return access(path, X_OK) == 0;
 }
+
+int make_dirs(const char *path, mode_t mode)
+{
+    if (!path || !*path) {
+        return -1;
+    }
+
+    char *buf = strdup(path);
+    if (!buf) {
+        return -1;
+    }
+
+    for (char *p = buf + 1; ; p++) {
+        if (*p != '/' && *p != '\0') {
+            continue;
+        }
+
+        char saved = *p;
+        *p = '\0';
+        if (mkdir(buf, mode) != 0 && errno != EEXIST) {
+            free(buf);
+            return -1;
+        }
+        *p = saved;
+
+        if (saved == '\0') {
+            break;
+        }
+    }
+
+    free(buf);
+    return dir_exists(path) ? 0 : -1;
+}
+
+char *self_path(const char *argv0)
+{
+    char *path = realpath("/proc/self/exe", NULL);
+    if (!path && argv0 && strchr(argv0, '/')) {
+        path = realpath(argv0, NULL);
+    }
+    return path;
+}
+
+void set_root_dir(const char *root)
+{
+    free(g_root_dir);
+    g_root_dir = root && *root && strcmp(root, "/") != 0 ? strdup(root) : NULL;
+}
+
+const char *root_dir(void)
+{
+    return g_root_dir ? g_root_dir : "";
+}
+
+char *rooted_path(const char *path)
+{
+    if (!path) {
+        return NULL;
+    }
+    if (!g_root_dir || path[0] != '/') {
+        return strdup(path);
+    }
+
+    size_t len = strlen(g_root_dir) + strlen(path) + 1;
+    char *full = malloc(len);
+    if (full) {
+        snprintf(full, len, "%s%s", g_root_dir, path);
+    }
+    return full;
+}
@@ -13,6 +13,7 @@
 #define SWITCH_UTILS_H
 
 #include <stdbool.h>
+#include <sys/types.h>
 
 /* Color codes */
 typedef enum {
@@ -63,4 +64,24 @@ bool dir_exists(const char *path);
 /* Check if file is executable */
 bool is_executable(const char *path);
 
+/* Create a directory and any missing parents */
+int make_dirs(const char *path, mode_t mode);
+
+/*
+ * Absolute path of the running executable (caller frees), from
+ * /proc/self/exe or else argv0 when it names a path. NULL if unknown.
+ */
+char *self_path(const char *argv0);
+
+/*
+ * Directory managed paths (links, alternatives, watched paths) live under,
+ * for configuring an image tree; "" for the running system. Set once per
+ * process with set_root_dir() (an absolute, resolved path).
+ */
+void set_root_dir(const char *root);
+const char *root_dir(void);
+
+/* Host path of an absolute path inside the root (caller frees) */
+char *rooted_path(const char *path);
+
 #endif /* SWITCH_UTILS_H */